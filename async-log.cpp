@@ -0,0 +1,268 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <unistd.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+
+#include "thread-tuning.h"
+#include "async-log.h"
+
+namespace {
+
+/// A bounded queue of fixed size messages. Producers claim a slot by bumping m_head, the single
+/// consumer waits for each slot's sequence to say it has been written. The consumer sleeps on a
+/// condition variable when the ring is empty, and only then does a producer touch the mutex to wake it.
+class LogRing {
+public:
+  LogRing();
+  ~LogRing();
+
+  void Push(LogLevel level, unsigned heldBack, const char *format, va_list args);
+
+private:
+  static constexpr size_t SlotCount = 256;
+  static constexpr int SlotSize = LogMessageMax + 32;
+
+  struct Slot {
+    std::atomic<size_t> m_sequence;
+    int m_length;
+    char m_text[SlotSize];
+  };
+
+  /// writes out whatever is ready, returns false if there was nothing.
+  bool Drain();
+  /// whether the next slot for the consumer has been written.
+  bool IsReady() const;
+  void WriteOut(const char *text, size_t length);
+  void ThreadMain();
+
+  Slot m_slots[SlotCount];
+  std::atomic<size_t> m_head{0};
+  /// only the consumer touches this.
+  size_t m_tail = 0;
+  std::atomic<unsigned> m_dropped{0};
+  std::atomic<bool> m_stopping{false};
+  /// set while the consumer is waiting, or about to wait, on m_wake.
+  std::atomic<bool> m_sleeping{false};
+  std::mutex m_wakeMutex;
+  std::condition_variable m_wake;
+  std::once_flag m_started;
+  std::thread m_thread;
+};
+
+LogRing::LogRing()
+{
+  for(size_t n = 0; n<SlotCount; n++)
+    m_slots[n].m_sequence.store(n, std::memory_order_relaxed);
+}
+
+LogRing::~LogRing()
+{
+  // whatever is still in the ring goes out before exit.
+  {
+    std::lock_guard<std::mutex> lock(m_wakeMutex);
+    m_stopping = true;
+  }
+  m_wake.notify_one();
+  if(m_thread.joinable())
+    m_thread.join();
+  Drain();
+}
+
+void LogRing::Push(LogLevel level, unsigned heldBack, const char *format, va_list args)
+{
+  std::call_once(m_started, [this]() {
+    // the first message can come from a thread pinned to a core the writer shouldn't share.
+    ScopedUnplacedThread unplaced;
+    m_thread = std::thread([this]() { ThreadMain(); });
+  });
+
+  size_t pos = m_head.load(std::memory_order_relaxed);
+  Slot *slot;
+  for(;;) {
+    slot = &m_slots[pos % SlotCount];
+    const size_t sequence = slot->m_sequence.load(std::memory_order_acquire);
+    const intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+    if(diff == 0) {
+      if(m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+	break;
+    } else if(diff < 0) {
+      // the consumer hasn't caught up, rather than wait the message is lost.
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    } else {
+      pos = m_head.load(std::memory_order_relaxed);
+    }
+  }
+
+  int length = 0;
+  if(level == LOG_LEVEL_WARNING)
+    length = snprintf(slot->m_text, SlotSize, "Warning: ");
+  else if(level == LOG_LEVEL_ERROR)
+    length = snprintf(slot->m_text, SlotSize, "Error: ");
+  // a bad format gives a negative count, which mustn't take the length below the prefix.
+  const int formatted = vsnprintf(slot->m_text + length, LogMessageMax - length, format, args);
+  if(formatted > 0)
+    length += formatted;
+  length = std::max(0, std::min(length, LogMessageMax - 1));
+  if(length > 0 && slot->m_text[length - 1] == '\n')
+    --length;
+  if(heldBack) {
+    const int suffix = snprintf(slot->m_text + length, SlotSize - length, " (%u more held back)", heldBack);
+    if(suffix > 0)
+      length = std::min(length + suffix, SlotSize - 1);
+  }
+  slot->m_text[length++] = '\n';
+  slot->m_length = length;
+  slot->m_sequence.store(pos + 1, std::memory_order_release);
+
+  // pairs with the fence in ThreadMain, either the consumer sees this slot or this sees it asleep.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if(m_sleeping.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(m_wakeMutex);
+    m_wake.notify_one();
+  }
+}
+
+bool LogRing::IsReady() const
+{
+  return m_slots[m_tail % SlotCount].m_sequence.load(std::memory_order_acquire) == m_tail + 1;
+}
+
+bool LogRing::Drain()
+{
+  bool any = false;
+  for(;;) {
+    Slot& slot = m_slots[m_tail % SlotCount];
+    if(slot.m_sequence.load(std::memory_order_acquire) != m_tail + 1)
+      break;
+    WriteOut(slot.m_text, slot.m_length);
+    slot.m_sequence.store(m_tail + SlotCount, std::memory_order_release);
+    ++m_tail;
+    any = true;
+  }
+
+  const unsigned dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+  if(dropped) {
+    char text[64];
+    const int length = snprintf(text, sizeof(text), "(%u log messages dropped)\n", dropped);
+    WriteOut(text, length);
+  }
+  return any;
+}
+
+void LogRing::WriteOut(const char *text, size_t length)
+{
+  // straight to the descriptor, stdout's lock might be held by a printf on another thread.
+  while(length) {
+    const ssize_t written = write(STDOUT_FILENO, text, length);
+    if(written < 0) {
+      if(errno == EINTR)
+	continue;
+      return;
+    }
+    text += written;
+    length -= written;
+  }
+}
+
+void LogRing::ThreadMain()
+{
+  while(!m_stopping) {
+    if(Drain())
+      continue;
+
+    // nothing is waiting so sleep until a producer says otherwise, which keeps the core idle while the display is blanked.
+    std::unique_lock<std::mutex> lock(m_wakeMutex);
+    m_sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(!IsReady() && !m_stopping)
+      m_wake.wait(lock);
+    m_sleeping.store(false, std::memory_order_relaxed);
+  }
+}
+
+LogRing g_logRing;
+std::atomic<int> g_logLevel{LOG_LEVEL_INFO};
+
+/// each call site's format string and when it may next log.
+struct RateLimit {
+  std::atomic<const char *> m_format{nullptr};
+  std::atomic<int64_t> m_nextMS{0};
+  std::atomic<unsigned> m_heldBack{0};
+};
+constexpr int RateLimitCount = 32;
+RateLimit g_rateLimits[RateLimitCount];
+
+RateLimit *FindRateLimit(const char *format)
+{
+  const size_t start = (uintptr_t(format) >> 3) % RateLimitCount;
+  for(int n = 0; n<RateLimitCount; n++) {
+    RateLimit& limit = g_rateLimits[(start + n) % RateLimitCount];
+    const char *expected = limit.m_format.load(std::memory_order_acquire);
+    if(expected == nullptr && limit.m_format.compare_exchange_strong(expected, format))
+      return &limit;
+    if(expected == format)
+      return &limit;
+  }
+  return nullptr;
+}
+
+}
+
+void SetLogLevel(LogLevel level)
+{
+  g_logLevel = level;
+}
+
+void LogMessage(LogLevel level, const char *format, ...)
+{
+  if(level < g_logLevel.load(std::memory_order_relaxed))
+    return;
+  
+  va_list args;
+  va_start(args, format);
+  g_logRing.Push(level, 0, format, args);
+  va_end(args);
+}
+
+void LogRateLimited(LogLevel level, int intervalMS, const char *format, ...)
+{
+  if(level < g_logLevel.load(std::memory_order_relaxed))
+    return;
+
+  // with the table full the message just isn't limited.
+  unsigned heldBack = 0;
+  RateLimit *limit = FindRateLimit(format);
+  if(limit) {
+    const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t next = limit->m_nextMS.load(std::memory_order_relaxed);
+    if(now < next || !limit->m_nextMS.compare_exchange_strong(next, now + intervalMS)) {
+      limit->m_heldBack.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    heldBack = limit->m_heldBack.exchange(0, std::memory_order_relaxed);
+  }
+  
+  va_list args;
+  va_start(args, format);
+  g_logRing.Push(level, heldBack, format, args);
+  va_end(args);
+}
@@ -0,0 +1,32 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+/// How much a log message matters, messages under the level given to SetLogLevel are thrown away
+/// before they are formatted.
+enum LogLevel {
+  LOG_LEVEL_DEBUG,
+  LOG_LEVEL_INFO,
+  LOG_LEVEL_WARNING,
+  LOG_LEVEL_ERROR
+};
+
+/// the default is LOG_LEVEL_INFO.
+void SetLogLevel(LogLevel level);
+
+/// Formats a message like printf into a ring buffer which a background thread writes to stdout,
+/// so the caller never waits on the console. When the ring is full the message is dropped and
+/// counted, and messages longer than LogMessageMax are cut short. Any thread can log.
+void LogMessage(LogLevel level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+/// LogMessage for things which can repeat every frame, the message from each 'format' gets through at
+/// most once every 'intervalMS' and says how many were held back since the last one.
+void LogRateLimited(LogLevel level, int intervalMS, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+constexpr int LogMessageMax = 240;
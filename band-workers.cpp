@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <stdint.h>
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+#include "band-workers.h"
+#include "thread-tuning.h"
+
+void BandWorkers::Start(int threads)
+{
+  Stop();
+  if(threads <= 0)
+    threads = std::min<int>(MaxThreads, std::max(1u, std::thread::hardware_concurrency()));
+
+  // the workers are given the generation to wait past so a job started before they get going isn't missed.
+  m_stopping = false;
+  const unsigned generation = m_generation;
+  for(int band = 1; band<threads; band++)
+    m_threads.emplace_back([this, band, generation]() { WorkerMain(band, generation); });
+}
+
+bool BandWorkers::SetPlacement(const ThreadPlacement& placement)
+{
+  bool ok = true;
+  for(auto& thread : m_threads)
+    ok = ApplyThreadPlacement(thread, placement, "present worker") && ok;
+  return ok;
+}
+
+void BandWorkers::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_wake.notify_all();
+  for(auto& thread : m_threads)
+    thread.join();
+  m_threads.clear();
+}
+
+void BandWorkers::RunBands(int rows, int rowPixels, BandFn fn, const void *ctx)
+{
+  const int64_t pixels = int64_t(rows) * rowPixels;
+  const int bands = int(std::min<int64_t>({int64_t(GetThreadCount()), int64_t(rows), pixels / MinBandPixels}));
+  if(bands <= 1) {
+    fn(ctx, 0, rows);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fn = fn;
+    m_ctx = ctx;
+    m_rows = rows;
+    m_bands = bands;
+    m_pending = bands - 1;
+    ++m_generation;
+  }
+  m_wake.notify_all();
+
+  fn(ctx, 0, rows / bands);
+  
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done.wait(lock, [this]() { return m_pending == 0; });
+}
+
+void BandWorkers::WorkerMain(int band, unsigned seen)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  while(true) {
+    m_wake.wait(lock, [&]() { return m_stopping || m_generation != seen; });
+    if(m_stopping)
+      return;
+    seen = m_generation;
+    if(band >= m_bands)
+      continue;
+
+    // nothing the job uses changes until the last band is done.
+    lock.unlock();
+    m_fn(m_ctx, (m_rows * band) / m_bands, (m_rows * (band + 1)) / m_bands);
+    lock.lock();
+    if(--m_pending == 0)
+      m_done.notify_one();
+  }
+}
@@ -0,0 +1,54 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+/// A few persistent threads which share out row based work, such as copying the back buffer to the
+/// screen, as bands of rows. The calling thread does the first band itself and waits for the rest,
+/// small jobs aren't worth waking anyone for and just run on the caller.
+class BandWorkers {
+public:
+  BandWorkers() { }
+  ~BandWorkers() { Stop(); }
+
+  /// 'threads' counts the caller, zero means one per core up to MaxThreads.
+  void Start(int threads);
+  void Stop();
+  int GetThreadCount() const { return int(m_threads.size()) + 1; }
+  /// moves the worker threads, not the caller, see thread-tuning.h.
+  bool SetPlacement(const struct ThreadPlacement& placement);
+
+  /// calls fn(first, end) over bands covering rows 0 to 'rows', 'rowPixels' says how much work a row is.
+  template<typename F> void Run(int rows, int rowPixels, const F& fn) {
+    RunBands(rows, rowPixels, [](const void *ctx, int first, int end) { (*(const F *)ctx)(first, end); }, &fn);
+  }
+
+  static constexpr int MaxThreads = 4;
+  /// below this many pixels a band costs less than the wake up.
+  static constexpr int MinBandPixels = 32 * 1024;
+
+private:
+  typedef void (*BandFn)(const void *ctx, int first, int end);
+  void RunBands(int rows, int rowPixels, BandFn fn, const void *ctx);
+  void WorkerMain(int band, unsigned seen);
+
+  std::vector<std::thread> m_threads;
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::condition_variable m_done;
+  /// bumped for each job so the workers can tell a new one from a spurious wake up.
+  unsigned m_generation = 0;
+  bool m_stopping = false;
+  int m_pending = 0;
+  
+  BandFn m_fn = nullptr;
+  const void *m_ctx = nullptr;
+  int m_rows = 0;
+  int m_bands = 0;
+};
@@ -0,0 +1,552 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <unistd.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <dirent.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+
+#include <cairo.h>
+
+#include "thread-tuning.h"
+#include "video-pacer.h"
+#include "fb-display.h"
+#include "kbhit.h"
+#include "page-data.h"
+#include "page-bundle.h"
+#include "frame-arena.h"
+#include "span-composite.h"
+#include "band-workers.h"
+#include "quanterm-app.h"
+
+// quanterm-bench - times the rendering stack against a real page set on an offscreen display
+// and writes the results as JSON so builds can be compared.
+
+class QuanTermBench {
+public:
+  int BenchMain(int ac, char **av);
+
+private:
+  /// timings are in microseconds.
+  struct Stats {
+    size_t m_count = 0;
+    double m_min = 0.0;
+    double m_median = 0.0;
+    double m_p99 = 0.0;
+    double m_mean = 0.0;
+  };
+
+  static Stats Summarise(std::vector<double> samples);
+  void WriteStats(const char *name, const Stats& stats);
+
+  /// JSON members are written with the comma before them, so a measurement that is skipped never
+  /// leaves one dangling. BeginJson opens an object or array, 'name' is null for an array element.
+  void NextEntry();
+  void WriteField(const char *name, const char *format, ...);
+  void BeginJson(const char *name, char bracket);
+  void EndJson(char bracket);
+
+  /// times 'fn' 'iterations' times, resetting the frame arena between each as the main loop does.
+  template<typename F> Stats Measure(int iterations, F fn);
+
+  bool BenchPage(const std::string& name);
+  void BenchPresent(int bpp);
+  /// full screen presents and clears at 1280x1024 with one thread and up to a thread per core.
+  void BenchScaling();
+  void BenchAttractor();
+  /// prerenders the pages 'name' links to, then checks drawing its buttons again redraws no strips,
+  /// returning false if it did.
+  bool BenchButtonStrips(const std::string& name);
+  /// FBDisplay's compositing against cairo doing the same job.
+  void BenchComposite();
+  /// attractor frames paced to 60fps against a busy thread per core, as the kernel leaves the
+  /// main loop and then with the page config's placement or, without one, SCHED_FIFO on the last core.
+  void BenchJitter();
+  void RunJitter(const char *name);
+
+  QuanTermApp m_app;
+  int m_iterations = 20;
+  FILE *m_out = nullptr;
+  /// one per open object or array, whether nothing has been written in it yet.
+  std::vector<bool> m_firstEntry;
+};
+
+QuanTermBench::Stats QuanTermBench::Summarise(std::vector<double> samples)
+{
+  Stats stats;
+  if(samples.empty())
+    return stats;
+  
+  std::sort(samples.begin(), samples.end());
+  const size_t n = samples.size();
+  stats.m_count = n;
+  stats.m_min = samples[0];
+  stats.m_median = (n & 1) ? samples[n/2] : (samples[n/2 - 1] + samples[n/2]) / 2.0;
+  stats.m_p99 = samples[std::min(n - 1, (size_t)std::ceil(n * 0.99) - 1)];
+  double total = 0.0;
+  for(double s : samples)
+    total += s;
+  stats.m_mean = total / n;
+  return stats;
+}
+
+void QuanTermBench::NextEntry()
+{
+  fprintf(m_out, "%s%*s", m_firstEntry.back() ? "\n" : ",\n", int(m_firstEntry.size()) * 2, "");
+  m_firstEntry.back() = false;
+}
+
+void QuanTermBench::WriteField(const char *name, const char *format, ...)
+{
+  NextEntry();
+  fprintf(m_out, "\"%s\": ", name);
+  va_list args;
+  va_start(args, format);
+  vfprintf(m_out, format, args);
+  va_end(args);
+}
+
+void QuanTermBench::BeginJson(const char *name, char bracket)
+{
+  if(!m_firstEntry.empty()) {
+    NextEntry();
+    if(name)
+      fprintf(m_out, "\"%s\": ", name);
+  }
+  fputc(bracket, m_out);
+  m_firstEntry.push_back(true);
+}
+
+void QuanTermBench::EndJson(char bracket)
+{
+  m_firstEntry.pop_back();
+  fprintf(m_out, "\n%*s%c", int(m_firstEntry.size()) * 2, "", bracket);
+}
+
+void QuanTermBench::WriteStats(const char *name, const Stats& stats)
+{
+  NextEntry();
+  fprintf(m_out, "\"%s\": {\"count\": %zu, \"min\": %.2f, \"median\": %.2f, \"p99\": %.2f, \"mean\": %.2f}",
+	  name, stats.m_count, stats.m_min, stats.m_median, stats.m_p99, stats.m_mean);
+  printf("  %-16s median %10.2fus  p99 %10.2fus  (%zu)\n", name, stats.m_median, stats.m_p99, stats.m_count);
+}
+
+template<typename F> QuanTermBench::Stats QuanTermBench::Measure(int iterations, F fn)
+{
+  std::vector<double> samples;
+  samples.reserve(iterations);
+  for(int n = 0; n<iterations; n++) {
+    m_app.m_frameArena.Reset();
+    const double start = GetTimeMS();
+    fn();
+    samples.push_back((GetTimeMS() - start) * 1000.0);
+  }
+  return Summarise(samples);
+}
+
+bool QuanTermBench::BenchPage(const std::string& name)
+{
+  PageDocument doc;
+  std::vector<ButtonData> buttons;
+  
+  // the page dump is debug logging, which costs next to nothing unless -verbose is on.
+  auto Parse = [&]() {
+    return m_app.ReadPageData(name, doc, buttons);
+  };
+
+  if(!Parse())
+    return false;
+  
+  printf("%s\n", name.c_str());
+  BeginJson(nullptr, '{');
+  WriteField("name", "\"%s\"", name.c_str());
+  WriteField("length", "%u", doc.GetLength());
+  WriteField("buttons", "%zu", buttons.size());
+  WriteStats("parse", Measure(m_iterations, Parse));
+
+  auto FlushCairo = []() {
+    cairo_surface_flush(cairo_get_target(CairoInst()));
+  };
+  
+  WriteStats("full_render", Measure(m_iterations, [&]() {
+    DisplayInst().Clear(DisplayInst().GetScreenRect());
+    m_app.RenderSideButtons(buttons);
+    m_app.RenderPageContent(doc, doc.GetLength());
+    FlushCairo();
+  }));
+
+  // every frame of the typewriter reveal, as the main loop steps m_pageProgress.
+  std::vector<double> revealSamples;
+  const int step = std::max(1, int(m_app.m_pageCfg.ScrollSpeed));
+  for(int sweep = 0; sweep<std::max(1, m_iterations / 10); sweep++) {
+    DisplayInst().Clear(DisplayInst().GetScreenRect());
+    for(int progress = 0; progress < (int)doc.GetLength(); ) {
+      progress = std::min((int)doc.GetLength(), progress + step);
+      m_app.m_frameArena.Reset();
+      const double start = GetTimeMS();
+      m_app.RenderPageContent(doc, progress);
+      FlushCairo();
+      revealSamples.push_back((GetTimeMS() - start) * 1000.0);
+    }
+  }
+  WriteStats("reveal_frame", Summarise(revealSamples));
+  EndJson('}');
+  return true;
+}
+
+void QuanTermBench::BenchPresent(int bpp)
+{
+  FBDisplayConfig config;
+  config.m_backend = FBDisplayConfig::MEMORY;
+  config.m_width = DisplayInst().GetScreenWidth();
+  config.m_height = DisplayInst().GetScreenHeight();
+  config.m_bpp = bpp;
+
+  FBDisplay display;
+  display.SetConfig(config);
+  if(!display.Open())
+    return;
+  
+  char name[32];
+  sprintf(name, "present_%ibpp", bpp);
+  WriteStats(name, Measure(m_iterations * 10, [&]() {
+    display.PresentAll();
+  }));
+}
+
+void QuanTermBench::BenchScaling()
+{
+  constexpr int Width = 1280;
+  constexpr int Height = 1024;
+  WriteField("width", "%i", Width);
+  WriteField("height", "%i", Height);
+  WriteField("cores", "%u", std::thread::hardware_concurrency());
+  
+  for(int threads = 1; threads<=BandWorkers::MaxThreads; threads++) {
+    for(int bpp : {16, 32}) {
+      FBDisplayConfig config;
+      config.m_backend = FBDisplayConfig::MEMORY;
+      config.m_width = Width;
+      config.m_height = Height;
+      config.m_bpp = bpp;
+      config.m_threads = threads;
+
+      FBDisplay display;
+      display.SetConfig(config);
+      if(!display.Open())
+	return;
+      
+      char name[32];
+      if(bpp == 32) {
+	sprintf(name, "clear_%it", threads);
+	WriteStats(name, Measure(m_iterations * 10, [&]() {
+	  display.Clear(display.GetScreenRect());
+	}));
+      }
+      sprintf(name, "present_%ibpp_%it", bpp, threads);
+      WriteStats(name, Measure(m_iterations * 10, [&]() {
+	display.PresentAll();
+      }));
+    }
+  }
+}
+
+void QuanTermBench::BenchAttractor()
+{
+  // the first frame loads the logo so keep it out of the numbers.
+  m_app.RenderAttractorScreen();
+  WriteStats("attractor_frame", Measure(m_iterations * 10, [&]() {
+    m_app.RenderAttractorScreen();
+  }));
+}
+
+bool QuanTermBench::BenchButtonStrips(const std::string& name)
+{
+  PageDocument doc;
+  std::vector<ButtonData> buttons;
+  if(!m_app.ReadPageData(name, doc, buttons))
+    return true;
+
+  // PrerenderNextPage follows the links of the page on screen.
+  m_app.m_buttons = buttons;
+  m_app.RenderSideButtons(buttons);
+  int prerendered = 0;
+  while(m_app.PrerenderNextPage())
+    ++prerendered;
+
+  const unsigned before = m_app.m_stripRenders;
+  WriteStats("side_buttons", Measure(m_iterations, [&]() {
+    m_app.RenderSideButtons(buttons);
+  }));
+  const unsigned redrawn = m_app.m_stripRenders - before;
+  WriteField("page", "\"%s\"", name.c_str());
+  WriteField("prerendered", "%i", prerendered);
+  WriteField("strips_redrawn", "%u", redrawn);
+  if(redrawn) {
+    printf("Error: %u button strips of '%s' were redrawn with the same captions\n", redrawn, name.c_str());
+    return false;
+  }
+  return true;
+}
+
+void QuanTermBench::BenchComposite()
+{
+  // a sprite with a soft edge and a coverage mask, about the size of a large attractor logo.
+  constexpr int Size = 256;
+  std::vector<uint32_t> sprite(Size * Size);
+  std::vector<uint8_t> mask(Size * Size);
+  for(int y = 0; y<Size; y++) {
+    for(int x = 0; x<Size; x++) {
+      const double dist = std::hypot(x - Size / 2, y - Size / 2) / (Size / 2);
+      const uint32_t alpha = std::min(255, std::max(0, int(255 * (1.2 - dist))));
+      sprite[y * Size + x] = PremultiplyColor((alpha << 24) | (x << 16) | (y << 8) | 0x80);
+      mask[y * Size + x] = (x * y) >> 8;
+    }
+  }
+  
+  cairo_surface_t *spriteSurface = cairo_image_surface_create_for_data((unsigned char *)&sprite[0], CAIRO_FORMAT_ARGB32,
+								       Size, Size, Size * 4);
+  cairo_surface_t *maskSurface = cairo_image_surface_create_for_data(&mask[0], CAIRO_FORMAT_A8, Size, Size, Size);
+  cairo_surface_t *surface565 = cairo_image_surface_create(CAIRO_FORMAT_RGB16_565, Size, Size);
+  cairo_t *cr565 = cairo_create(surface565);
+  std::vector<uint16_t> pixels565(Size * Size);
+  
+  cairo_t *cr = CairoInst();
+  constexpr int x = 100;
+  constexpr int y = 100;
+  const int iterations = m_iterations * 10;
+
+  WriteStats("image_alpha", Measure(iterations, [&]() {
+    DisplayInst().CompositeImage(&sprite[0], Size * 4, Size, Size, x, y, 128);
+  }));
+  WriteStats("cairo_image_alpha", Measure(iterations, [&]() {
+    cairo_set_source_surface(cr, spriteSurface, x, y);
+    cairo_paint_with_alpha(cr, 0.5);
+    cairo_surface_flush(cairo_get_target(cr));
+  }));
+  WriteStats("fill", Measure(iterations, [&]() {
+    DisplayInst().CompositeFill(x, y, Size, Size, 0x80336699);
+  }));
+  WriteStats("cairo_fill", Measure(iterations, [&]() {
+    cairo_set_source_rgba(cr, 0.2, 0.4, 0.6, 0.5);
+    cairo_rectangle(cr, x, y, Size, Size);
+    cairo_fill(cr);
+    cairo_surface_flush(cairo_get_target(cr));
+  }));
+  WriteStats("mask", Measure(iterations, [&]() {
+    DisplayInst().CompositeMask(&mask[0], Size, Size, Size, x, y, 0xffffffff);
+  }));
+  WriteStats("cairo_mask", Measure(iterations, [&]() {
+    cairo_set_source_rgb(cr, 1.0, 1.0, 1.0);
+    cairo_mask_surface(cr, maskSurface, x, y);
+    cairo_surface_flush(cairo_get_target(cr));
+  }));
+  WriteStats("image_alpha_565", Measure(iterations, [&]() {
+    for(int row = 0; row<Size; row++)
+      CompositeSpanOverAlpha(&pixels565[row * Size], &sprite[row * Size], Size, 128);
+  }));
+  WriteStats("cairo_image_alpha_565", Measure(iterations, [&]() {
+    cairo_set_source_surface(cr565, spriteSurface, 0, 0);
+    cairo_paint_with_alpha(cr565, 0.5);
+    cairo_surface_flush(surface565);
+  }));
+
+  cairo_destroy(cr565);
+  cairo_surface_destroy(surface565);
+  cairo_surface_destroy(maskSurface);
+  cairo_surface_destroy(spriteSurface);
+}
+
+void QuanTermBench::RunJitter(const char *name)
+{
+  constexpr double FrameMS = 1000.0 / 60.0;
+  /// later than this and the frame would have shown a vsync late.
+  constexpr double MissMS = 1.0;
+  const int frames = m_iterations * 15;
+  
+  std::vector<double> lateness;
+  int misses = 0;
+  double deadline = GetTimeMS() + FrameMS;
+  for(int n = 0; n<frames; n++) {
+    m_app.m_frameArena.Reset();
+    m_app.RenderAttractorScreen();
+    const double now = GetTimeMS();
+    if(now < deadline)
+      usleep(useconds_t((deadline - now) * 1000.0));
+
+    const double late = GetTimeMS() - deadline;
+    lateness.push_back(late * 1000.0);
+    if(late > MissMS)
+      ++misses;
+    // a missed frame is dropped rather than making every later one late too.
+    deadline += FrameMS;
+    while(deadline < GetTimeMS())
+      deadline += FrameMS;
+  }
+
+  const Stats stats = Summarise(lateness);
+  NextEntry();
+  fprintf(m_out, "\"%s\": {\"frames\": %i, \"misses\": %i, \"late_median\": %.2f, \"late_p99\": %.2f, \"late_max\": %.2f}",
+	  name, frames, misses, stats.m_median, stats.m_p99, *std::max_element(lateness.begin(), lateness.end()));
+  printf("  %-16s %i of %i frames missed, late by median %.2fus p99 %.2fus\n", name, misses, frames, stats.m_median, stats.m_p99);
+}
+
+void QuanTermBench::BenchJitter()
+{
+  // stands in for libvlc decoding a video on every core.
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> load;
+  const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  for(unsigned n = 0; n<cores; n++) {
+    load.emplace_back([&stop]() {
+      volatile unsigned spin = 0;
+      while(!stop.load(std::memory_order_relaxed))
+	spin = spin + 1;
+    });
+  }
+  WriteField("load_threads", "%u", cores);
+
+  RunJitter("default");
+
+  // the tuned run goes last as it can't be undone.
+  ThreadPlacement placement = m_app.GetThreadPlacement(m_app.m_pageCfg.RenderCPUMask);
+  if(placement.IsDefault()) {
+    placement.m_cpuMask = 1u << (cores - 1);
+    placement.m_policy = SCHED_POLICY_FIFO;
+    placement.m_priority = int(m_app.m_pageCfg.RealtimePriority);
+  }
+  const bool placed = ApplyThreadPlacement(placement, "benchmark");
+  const bool locked = LockMemory(DisplayInst().GetSurfacePtr(), DisplayInst().GetStride() * DisplayInst().GetScreenHeight(), "back buffer");
+  WriteField("tuned_cores", "%u", placement.m_cpuMask);
+  WriteField("tuned_policy", "%i", int(placement.m_policy));
+  WriteField("tuned_applied", "%s", placed && locked ? "true" : "false");
+  RunJitter("tuned");
+
+  stop = true;
+  for(auto& thread : load)
+    thread.join();
+}
+
+int QuanTermBench::BenchMain(int ac, char **av)
+{
+  FBDisplayConfig config;
+  config.Parse("memory:800x600x32");
+  const char *outFile = "quanterm-bench.json";
+  
+  for(int n = 1; n<ac; n++) {
+    if(strcmp(av[n], "-fb") == 0 && (n + 1) < ac) {
+      if(!config.Parse(av[++n]))
+	return 1;
+    } else if(strcmp(av[n], "-bundle") == 0 && (n + 1) < ac) {
+      m_app.OpenBundle(av[++n]);
+    } else if(strcmp(av[n], "-iterations") == 0 && (n + 1) < ac) {
+      m_iterations = std::max(1, atoi(av[++n]));
+    } else if(strcmp(av[n], "-o") == 0 && (n + 1) < ac) {
+      outFile = av[++n];
+    } else {
+      m_app.SetPagesRoot(av[n]);
+    }
+  }
+
+  DisplayInst().SetConfig(config);
+  if(!DisplayInst().Open()) {
+    printf("Failed to open display\n");
+    return 1;
+  }
+
+  char pcFile[512];
+  sprintf(pcFile, "page-config-%ix%i.txt", DisplayInst().GetScreenWidth(), DisplayInst().GetScreenHeight());
+  if(!m_app.m_pageCfg.LoadPageConfig(pcFile))
+    printf("Using the default page config\n");
+
+  cairo_surface_t *surface = cairo_image_surface_create_for_data((unsigned char *)DisplayInst().GetSurfacePtr(),
+								 CAIRO_FORMAT_ARGB32, 
+								 DisplayInst().GetScreenWidth(),
+								 DisplayInst().GetScreenHeight(),
+								 DisplayInst().GetStride());
+  CairoInst() = cairo_create(surface);
+
+  // every page in the pages root, in name order so runs line up.
+  std::vector<std::string> pages;
+  if(DIR *dir = opendir(m_app.m_pagesRoot.c_str())) {
+    while(dirent *ent = readdir(dir)) {
+      const std::string fname = ent->d_name;
+      if(fname.size() > 4 && fname.compare(fname.size() - 4, 4, ".txt") == 0 && fname.compare(0, 12, "page-config-") != 0)
+	pages.push_back(fname);
+    }
+    closedir(dir);
+  }
+  std::sort(pages.begin(), pages.end());
+
+  m_out = fopen(outFile, "w");
+  if(!m_out) {
+    printf("Failed to create '%s'\n", outFile);
+    return 1;
+  }
+  
+  BeginJson(nullptr, '{');
+  WriteField("width", "%i", DisplayInst().GetScreenWidth());
+  WriteField("height", "%i", DisplayInst().GetScreenHeight());
+  WriteField("bpp", "%i", config.m_bpp);
+  WriteField("iterations", "%i", m_iterations);
+  WriteField("units", "\"us\"");
+  BeginJson("pages", '[');
+  for(const auto& page : pages)
+    BenchPage(page);
+  EndJson(']');
+  BeginJson("display", '{');
+  BenchPresent(16);
+  BenchPresent(32);
+  BenchAttractor();
+  EndJson('}');
+  BeginJson("buttons", '{');
+  const bool stripsKept = BenchButtonStrips("index.txt");
+  EndJson('}');
+  BeginJson("scaling", '{');
+  BenchScaling();
+  EndJson('}');
+  BeginJson("composite", '{');
+  WriteField("kernels", "\"%s\"", CompositeKernelName());
+  BenchComposite();
+  EndJson('}');
+  BeginJson("jitter", '{');
+  BenchJitter();
+  EndJson('}');
+  EndJson('}');
+  fputc('\n', m_out);
+  fclose(m_out);
+  
+  cairo_destroy(CairoInst());
+  cairo_surface_destroy(surface);
+  printf("Results written to '%s'\n", outFile);
+  return stripsKept ? 0 : 1;
+}
+
+int main(int ac, char **av)
+{
+  QuanTermBench bench;
+  return bench.BenchMain(ac, av);
+}
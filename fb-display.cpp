@@ -15,99 +15,315 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include <linux/fb.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
 
 #include <cmath>
 #include <cstdint>
 #include <vector>
 #include <functional>
+#include <atomic>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 
+#include "thread-tuning.h"
+#include "video-pacer.h"
 #include "fb-display.h"
+#include "band-workers.h"
+#include "pixel-format.h"
+#include "span-composite.h"
+#include "frame-timer.h"
 
 #include "vlc/vlc.h"
 
-const uint16_t MASK_R = 0b1111100000000000;
-const uint8_t SHIFT_R = (6 + 5);
-const uint16_t MASK_G = 0b0000011111100000;
-const uint8_t SHIFT_G = (5);
-const uint16_t MASK_B = 0b0000000000011111;
-const uint8_t SHIFT_B = (0);
+constexpr int ClearColor = 0xff000000;
 
-void FBDisplay::BlitImage16BitColorDoubleScale(const uint16_t *srcImg, int width, int height, int xpos, int ypos)
+bool FBRect::Contains(const FBRect& other) const
 {
-  if((xpos + width) > m_screenWidth)
-    width = m_screenWidth - xpos;
-  if((ypos + height) > m_screenHeight)
-    height = m_screenHeight - ypos;
-  if(width < 0 || height < 0)
+  return other.m_x >= m_x && other.m_y >= m_y &&
+    (other.m_x + other.m_width) <= (m_x + m_width) && (other.m_y + other.m_height) <= (m_y + m_height);
+}
+
+FBRect FBRect::Union(const FBRect& other) const
+{
+  if(IsEmpty())
+    return other;
+  if(other.IsEmpty())
+    return *this;
+  const int x0 = std::min(m_x, other.m_x);
+  const int y0 = std::min(m_y, other.m_y);
+  const int x1 = std::max(m_x + m_width, other.m_x + other.m_width);
+  const int y1 = std::max(m_y + m_height, other.m_y + other.m_height);
+  return FBRect{x0, y0, x1 - x0, y1 - y0};
+}
+
+FBRect FBRect::Intersect(const FBRect& other) const
+{
+  const int x0 = std::max(m_x, other.m_x);
+  const int y0 = std::max(m_y, other.m_y);
+  const int x1 = std::min(m_x + m_width, other.m_x + other.m_width);
+  const int y1 = std::min(m_y + m_height, other.m_y + other.m_height);
+  if(x0 >= x1 || y0 >= y1)
+    return FBRect();
+  return FBRect{x0, y0, x1 - x0, y1 - y0};
+}
+
+int FBRect::Subtract(const FBRect& other, FBRect out[4]) const
+{
+  const FBRect overlap = Intersect(other);
+  if(overlap.IsEmpty()) {
+    out[0] = *this;
+    return IsEmpty() ? 0 : 1;
+  }
+
+  // full width bands above and below the overlap, then the pieces either side of it.
+  const FBRect pieces[4] = {
+    FBRect{m_x, m_y, m_width, overlap.m_y - m_y},
+    FBRect{m_x, overlap.m_y + overlap.m_height, m_width, (m_y + m_height) - (overlap.m_y + overlap.m_height)},
+    FBRect{m_x, overlap.m_y, overlap.m_x - m_x, overlap.m_height},
+    FBRect{overlap.m_x + overlap.m_width, overlap.m_y, (m_x + m_width) - (overlap.m_x + overlap.m_width), overlap.m_height}
+  };
+  int count = 0;
+  for(const FBRect& piece : pieces) {
+    if(!piece.IsEmpty())
+      out[count++] = piece;
+  }
+  return count;
+}
+
+void FBRegion::Add(const FBRect& rect)
+{
+  if(rect.IsEmpty())
     return;
+  for(int n = 0; n<m_count; n++) {
+    if(m_rects[n].Contains(rect))
+      return;
+  }
   
-  if(m_bpp == 16) {
-    uint16_t *fbp = (uint16_t *)m_realFbp;        
-    for(int y = 0; y<height; y++) {
-      for(int j = 0; j<2; j++) {
-	uint16_t *dst = fbp + ((m_screenWidth) * ((y*2) + j + ypos)) + xpos;
-	const uint16_t *src = srcImg + (y * width);
-	for(int x = 0; x<width; x++) {
-	  uint16_t srcPix = *src++;
-	  uint16_t dstPix = ((srcPix & MASK_R) >> 11) | (srcPix & MASK_G) | ((srcPix & MASK_B) << 11);
-	  *dst++ = dstPix;
-	  *dst++ = dstPix;
-	}
-      }
-    }
+  RemoveInside(rect);
+  if(m_count < MaxRects) {
+    m_rects[m_count++] = rect;
     return;
-  }    
-  
-  if(m_bpp == 32) {
-    int *fbp = (int *)m_realFbp;    
-    for(int y = 0; y<height; y++) {
-      for(int j = 0; j<2; j++) {
-	int *dst = fbp + ((m_screenWidth) * ((y*2) + j + ypos)) + xpos;
-	const uint16_t * src = srcImg + (y * width);
-	for(int x = 0; x<width; x++) {
-	  const uint32_t r = (*src & MASK_R) >> SHIFT_R;
-	  const uint32_t g = (*src & MASK_G) >> SHIFT_G;
-	  const uint32_t b = (*src & MASK_B) >> SHIFT_B;
-	  ++src;      
-	  const int pix = (int)(uint32_t)(0xff000000 | ((b << 3) << 16) | ((g << 2) << 8) | (r << 3));
-	  *dst++ = pix;
-	  *dst++ = pix;
-	}
-      }
+  }
+
+  int best = 0;
+  int bestGrowth = m_rects[0].Union(rect).GetArea() - m_rects[0].GetArea();
+  for(int n = 1; n<m_count; n++) {
+    const int growth = m_rects[n].Union(rect).GetArea() - m_rects[n].GetArea();
+    if(growth < bestGrowth) {
+      best = n;
+      bestGrowth = growth;
     }
-    return; 
+  }
+  m_rects[best] = m_rects[best].Union(rect);
+}
+
+void FBRegion::RemoveInside(const FBRect& rect)
+{
+  int kept = 0;
+  for(int n = 0; n<m_count; n++) {
+    if(!rect.Contains(m_rects[n]))
+      m_rects[kept++] = m_rects[n];
+  }
+  m_count = kept;
+}
+
+void FBDisplay::BlitImage16BitColorDoubleScale(const uint16_t *srcImg, int width, int height, int xpos, int ypos)
+{
+  const int srcWidth = width;
+  // a frame more than half the screen is centred off the edges, skip the source pixels which land
+  // there rather than not showing it.
+  if(xpos < 0) {
+    const int skip = (1 - xpos) / 2;
+    srcImg += skip;
+    width -= skip;
+    xpos += skip * 2;
+  }
+  if(ypos < 0) {
+    const int skip = (1 - ypos) / 2;
+    srcImg += skip * srcWidth;
+    height -= skip;
+    ypos += skip * 2;
+  }
+  width = std::min(width, (m_screenWidth - xpos) / 2);
+  height = std::min(height, (m_screenHeight - ypos) / 2);
+  if(width <= 0 || height <= 0)
+    return;
+
+  // both rows are converted from the frame rather than one copied to the other, reading back from
+  // video memory is slow.
+  const int bytesPerPixel = m_bpp / 8;
+  char *dst = m_realFbp + (ypos * m_frontStride) + (xpos * bytesPerPixel);
+  for(int y = 0; y<height; y++) {
+    const uint16_t *src = srcImg + (y * srcWidth);
+    m_pixelKernels->m_fromVideoDouble(dst, src, width);
+    m_pixelKernels->m_fromVideoDouble(dst + m_frontStride, src, width);
+    dst += m_frontStride * 2;
   }
 }
 
 void FBDisplay::BlitImage16BitColor(const uint16_t *srcImg, int width, int height, int xpos, int ypos)
 {
-  /*
+  const int srcWidth = width;
+  if(xpos < 0 || ypos < 0)
+    return;
+  width = std::min(width, m_screenWidth - xpos);
+  height = std::min(height, m_screenHeight - ypos);
+  if(width <= 0 || height <= 0)
+    return;
+
+  const int bytesPerPixel = m_bpp / 8;
+  char *dst = m_realFbp + (ypos * m_frontStride) + (xpos * bytesPerPixel);
+  for(int y = 0; y<height; y++) {
+    m_pixelKernels->m_fromVideo(dst, srcImg + (y * srcWidth), width);
+    dst += m_frontStride;
+  }
+}
+
+void FBDisplay::BlitYUVDoubleScale(const uint8_t *planes, int width, int height, int xpos, int ypos)
+{
+  const int srcWidth = width;
+  const int srcHeight = height;
+  // like the 16bit frames, a frame more than half the screen is centred off the edges and the
+  // source pixels which would land there are skipped.
+  int skipX = 0;
+  int skipY = 0;
+  if(xpos < 0) {
+    skipX = (1 - xpos) / 2;
+    width -= skipX;
+    xpos += skipX * 2;
+  }
+  if(ypos < 0) {
+    skipY = (1 - ypos) / 2;
+    height -= skipY;
+    ypos += skipY * 2;
+  }
+  width = std::min(width, (m_screenWidth - xpos) / 2);
+  height = std::min(height, (m_screenHeight - ypos) / 2);
+  if(width <= 0 || height <= 0)
+    return;
+
+  // the chroma planes are a quarter the size, one chroma row for every two luma rows.
+  const int chromaWidth = srcWidth / 2;
+  const int chromaHeight = srcHeight / 2;
+  if(chromaWidth <= 0 || chromaHeight <= 0)
+    return;
+  const uint8_t *yPlane = planes;
+  const uint8_t *uPlane = yPlane + (srcWidth * srcHeight);
+  const uint8_t *vPlane = uPlane + (chromaWidth * chromaHeight);
+
+  // the kernel takes columns in pairs sharing a chroma sample. An odd first column is the second
+  // of its pair, and with an odd width the last column has no chroma of its own and shares the
+  // one before rather than reading past the plane, both are converted on their own.
+  const bool oddFirst = (skipX & 1);
+  const int pairStart = skipX + oddFirst;
+  int pairedWidth = width - oddFirst;
+  const bool oddLast = (pairStart + pairedWidth > chromaWidth * 2);
+  if(oddLast)
+    --pairedWidth;
+  const int bytesPerPixel = m_bpp / 8;
+  char *dst = m_realFbp + (ypos * m_frontStride) + (xpos * bytesPerPixel);
+  for(int y = 0; y<height; y++) {
+    const int srcY = skipY + y;
+    const int chromaRow = std::min(srcY / 2, chromaHeight - 1) * chromaWidth;
+    const uint8_t *yRow = yPlane + (srcY * srcWidth);
+    char *out = dst;
+    if(oddFirst) {
+      const int chroma = chromaRow + (skipX / 2);
+      m_pixelKernels->m_fromYUVDouble(out, m_frontStride, yRow + skipX, uPlane + chroma, vPlane + chroma, 1);
+      out += 2 * bytesPerPixel;
+    }
+    if(pairedWidth > 0) {
+      const int chroma = chromaRow + (pairStart / 2);
+      m_pixelKernels->m_fromYUVDouble(out, m_frontStride, yRow + pairStart, uPlane + chroma, vPlane + chroma, pairedWidth);
+      out += pairedWidth * 2 * bytesPerPixel;
+    }
+    if(oddLast) {
+      const int chroma = chromaRow + chromaWidth - 1;
+      m_pixelKernels->m_fromYUVDouble(out, m_frontStride, yRow + pairStart + pairedWidth, uPlane + chroma, vPlane + chroma, 1);
+    }
+    dst += m_frontStride * 2;
+  }
+}
+
+void FBDisplay::BlitImage32BitColor(const uint32_t *srcImg, int srcStride, int width, int height, int xpos, int ypos)
+{
+  const char *src = (const char *)srcImg;
+  if(xpos < 0) {
+    src -= xpos * 4;
+    width += xpos;
+    xpos = 0;
+  }
+  if(ypos < 0) {
+    src -= ypos * srcStride;
+    height += ypos;
+    ypos = 0;
+  }
   if((xpos + width) > m_screenWidth)
     width = m_screenWidth - xpos;
   if((ypos + height) > m_screenHeight)
     height = m_screenHeight - ypos;
-  if(width < 0 || height < 0)
+  if(width <= 0 || height <= 0)
     return;
-    
-  int *fbp = (int *)m_fbp;
-  
-  // we are foolishly ignoring any stride here.
+
+  MarkContent(FBRect{xpos, ypos, width, height});
+  char *dst = m_fbp + (ypos * m_stride) + (xpos * 4);
   for(int y = 0; y<height; y++) {
-    int *dst = fbp + (m_screenWidth * (y + ypos)) + xpos;
-    const uint16_t * src = srcImg + (y * width);
-    for(int x = 0; x<width; x++) {
-      const uint32_t r = (*src & MASK_R) >> SHIFT_R;
-      const uint32_t g = (*src & MASK_G) >> SHIFT_G;
-      const uint32_t b = (*src & MASK_B) >> SHIFT_B;
-      ++src;      
-      const int pix = (int)(uint32_t)(0xff000000 | ((b << 3) << 16) | ((g << 2) << 8) | (r << 3));
-      *dst++ = pix;
-    }
+    memcpy(dst, src, width * 4);
+    dst += m_stride;
+    src += srcStride;
+  }
+}
+
+void FBDisplay::ScrollRegion(int x, int y, int width, int height, int dy)
+{
+  if(x < 0) {
+    width += x;
+    x = 0;
+  }
+  if(y < 0) {
+    height += y;
+    y = 0;
+  }
+  if((x + width) > m_screenWidth)
+    width = m_screenWidth - x;
+  if((y + height) > m_screenHeight)
+    height = m_screenHeight - y;
+  if(width <= 0 || dy == 0 || abs(dy) >= height)
+    return;
+  MarkContent(FBRect{x, y, width, height});
+
+  const int rows = height - abs(dy);
+  char *top = m_fbp + (y * m_stride) + (x * 4);
+  char *dst = dy > 0 ? top : top - (dy * m_stride);
+  const char *src = dy > 0 ? top + (dy * m_stride) : top;
+  
+  // full width rows are contiguous so they can go in one move.
+  if(width == m_screenWidth) {
+    memmove(dst, src, rows * m_stride);
+    return;
+  }
+
+  // otherwise row by row, in the order which doesn't overwrite rows before they've moved.
+  if(dy > 0) {
+    for(int row = 0; row<rows; row++)
+      memmove(dst + (row * m_stride), src + (row * m_stride), width * 4);
+  } else {
+    for(int row = rows - 1; row>=0; row--)
+      memmove(dst + (row * m_stride), src + (row * m_stride), width * 4);
   }
-  */
 }
 
 void FBDisplay::PutPixel(int x, int y, int color)
+{
+  MarkContent(FBRect{x, y, 1, 1});
+  PlotPixel(x, y, color);
+}
+
+void FBDisplay::PlotPixel(int x, int y, int color)
 {
   if(x < 0 || x >= m_screenWidth || y<0 || y>=m_screenHeight)
     return;
@@ -122,9 +338,10 @@ void FBDisplay::PlotLine(int x0, int y0, int x1, int y1, int color)
   int dy = -abs(y1 - y0);
   int sy = y0 < y1 ? 1 : -1;
   int error = dx + dy;
+  MarkContent(FBRect{std::min(x0, x1), std::min(y0, y1), dx + 1, 1 - dy});
 
   while(true) {
-    PutPixel(x0, y0, color);
+    PlotPixel(x0, y0, color);
     if (x0 == x1 && y0 == y1)
       break;
     int e2 = 2 * error;
@@ -144,81 +361,355 @@ void FBDisplay::PlotLine(int x0, int y0, int x1, int y1, int color)
 }
 
 
+void FBDisplay::PlotQuadrants(int x, int y, int dx, int dy, int color, bool clip)
+{
+  if(clip) {
+    PlotPixel(x + dx, y + dy, color);
+    PlotPixel(x - dx, y + dy, color);
+    PlotPixel(x + dx, y - dy, color);
+    PlotPixel(x - dx, y - dy, color);
+    return;
+  }
+
+  int *fb = (int *)m_fbp;
+  fb[(x + dx) + (y + dy) * m_screenWidth] = color;
+  fb[(x - dx) + (y + dy) * m_screenWidth] = color;
+  fb[(x + dx) + (y - dy) * m_screenWidth] = color;
+  fb[(x - dx) + (y - dy) * m_screenWidth] = color;
+}
+
 void FBDisplay::DrawCircle(int x, int y, int radius, int color)
 {
-  constexpr float sin0 = sin(0.0f);
-  constexpr float cos0 = cos(0.0f);
+  if(radius < 0)
+    return;
+  MarkContent(FBRect{x - radius, y - radius, (radius * 2) + 1, (radius * 2) + 1});
+  const bool clip = x - radius < 0 || y - radius < 0 || x + radius >= m_screenWidth || y + radius >= m_screenHeight;
+
+  // midpoint circle, one octant mirrored eight ways.
+  int dx = radius;
+  int dy = 0;
+  int error = 1 - radius;
+  while(dx >= dy) {
+    PlotQuadrants(x, y, dx, dy, color, clip);
+    PlotQuadrants(x, y, dy, dx, color, clip);
+    ++dy;
+    if(error < 0) {
+      error += 2 * dy + 1;
+    } else {
+      --dx;
+      error += 2 * (dy - dx) + 1;
+    }
+  }
+}
+
+void FBDisplay::DrawEllipse(int x, int y, int radiusX, int radiusY, int color)
+{
+  if(radiusX < 0 || radiusY < 0)
+    return;
+  MarkContent(FBRect{x - radiusX, y - radiusY, (radiusX * 2) + 1, (radiusY * 2) + 1});
+  const bool clip = x - radiusX < 0 || y - radiusY < 0 || x + radiusX >= m_screenWidth || y + radiusY >= m_screenHeight;
+
+  // midpoint ellipse in two regions, where the slope is shallower than -1 and then steeper.
+  const int64_t rx2 = int64_t(radiusX) * radiusX;
+  const int64_t ry2 = int64_t(radiusY) * radiusY;
+  int dx = 0;
+  int dy = radiusY;
+  int64_t px = 0;
+  int64_t py = 2 * rx2 * dy;
+  
+  int64_t error = ry2 - rx2 * radiusY + rx2 / 4;
+  while(px < py) {
+    PlotQuadrants(x, y, dx, dy, color, clip);
+    ++dx;
+    px += 2 * ry2;
+    if(error < 0) {
+      error += ry2 + px;
+    } else {
+      --dy;
+      py -= 2 * rx2;
+      error += ry2 + px - py;
+    }
+  }
+
+  error = ry2 * (2 * dx + 1) * (2 * dx + 1) / 4 + rx2 * (int64_t(dy) - 1) * (int64_t(dy) - 1) - rx2 * ry2;
+  while(dy >= 0) {
+    PlotQuadrants(x, y, dx, dy, color, clip);
+    --dy;
+    py -= 2 * rx2;
+    if(error > 0) {
+      error += rx2 - py;
+    } else {
+      ++dx;
+      px += 2 * ry2;
+      error += rx2 - py + px;
+    }
+  }
+}
+
+void FBDisplay::FillSpan(int y, int x0, int x1, int color)
+{
+  if(y < 0 || y >= m_screenHeight)
+    return;
+  x0 = std::max(x0, 0);
+  x1 = std::min(x1, m_screenWidth - 1);
+  if(x0 > x1)
+    return;
   
-  int lastPx = x + sin0 * radius;
-  int lastPy = y + cos0 * radius;
+  int *row = (int *)(m_fbp + (y * m_stride));
+  std::fill(row + x0, row + x1 + 1, color);
+}
+
+void FBDisplay::FillRows(const FBRect& rect, int color)
+{
+  m_workers->Run(rect.m_height, rect.m_width, [&](int first, int end) {
+    FillBand(FBRect{rect.m_x, rect.m_y + first, rect.m_width, end - first}, color);
+  });
+}
+
+void FBDisplay::FillBand(const FBRect& rect, int color)
+{
+  int *dst = (int *)(m_fbp + (rect.m_y * m_stride)) + rect.m_x;
   
-  for(int n = 1; n<=100; n++) {
-    float a = (2.0 * M_PI * n) / 100.0f;
-    int px = x + sin(a) * radius;
-    int py = y + cos(a) * radius;
-    PlotLine(lastPx, lastPy, px, py, color);
-    lastPx = px;
-    lastPy = py;
+  // full width rows are contiguous so they go in one fill.
+  if(rect.m_width == m_screenWidth) {
+    std::fill(dst, dst + (rect.m_width * rect.m_height), color);
+    return;
+  }
+
+  for(int row = 0; row<rect.m_height; row++) {
+    std::fill(dst, dst + rect.m_width, color);
+    dst += m_screenWidth;
   }
 }
 
-void FBDisplay::DrawEllipse(int x, int y, int radiusX, int radiusY, int color)
+void FBDisplay::FillRect(int x, int y, int width, int height, int color)
+{
+  const FBRect rect = FBRect{x, y, width, height}.Intersect(GetScreenRect());
+  if(rect.IsEmpty())
+    return;
+  
+  MarkContent(rect);
+  FillRows(rect, color);
+}
+
+void FBDisplay::FillCircle(int x, int y, int radius, int color)
 {
-  constexpr float sin0 = sin(0.0f);
-  constexpr float cos0 = cos(0.0f);
+  FillEllipse(x, y, radius, radius, color);
+}
+
+void FBDisplay::FillEllipse(int x, int y, int radiusX, int radiusY, int color)
+{
+  if(radiusX < 0 || radiusY < 0)
+    return;
+  MarkContent(FBRect{x - radiusX, y - radiusY, (radiusX * 2) + 1, (radiusY * 2) + 1});
+  
+  // the half width of each row only ever shrinks moving away from the centre so it is stepped down
+  // rather than worked out with a square root. The extra radius rounds the shape the same way as
+  // the midpoint outline.
+  const int64_t rx2 = int64_t(radiusX) * radiusX;
+  const int64_t ry2 = int64_t(radiusY) * radiusY;
+  const int64_t limit = rx2 * ry2 + (rx2 * radiusY + ry2 * radiusX) / 2;
   
-  int lastPx = x + sin0 * radiusX;
-  int lastPy = y + cos0 * radiusY;
+  // only the rows where at least one of the pair is on screen are filled.
+  const int dyStart = std::max(0, std::max(y - (m_screenHeight - 1), -y));
+  const int dyEnd = std::min(radiusY, std::max(m_screenHeight - 1 - y, y));
+  int halfWidth = radiusX;
+  for(int dy = 0; dy<=dyEnd; dy++) {
+    while(halfWidth > 0 && int64_t(halfWidth) * halfWidth * ry2 + int64_t(dy) * dy * rx2 > limit)
+      --halfWidth;
+    if(dy < dyStart)
+      continue;
+    FillSpan(y + dy, x - halfWidth, x + halfWidth, color);
+    if(dy)
+      FillSpan(y - dy, x - halfWidth, x + halfWidth, color);
+  }
+}
+
+void FBDisplay::FillRoundedRect(int x, int y, int width, int height, int radius, int color)
+{
+  if(width <= 0 || height <= 0)
+    return;
+  radius = std::max(0, std::min(radius, std::min(width, height) / 2));
+  MarkContent(FBRect{x, y, width, height});
+
+  // the straight middle section, then the rows with rounded ends stepped in from the corners.
+  FillRect(x, y + radius, width, height - (radius * 2), color);
   
-  for(int n = 1; n<=100; n++) {
-    float a = (2.0 * M_PI * n) / 100.0f;
-    int px = x + sin(a) * radiusX;
-    int py = y + cos(a) * radiusY;
-    PlotLine(lastPx, lastPy, px, py, color);
-    lastPx = px;
-    lastPy = py;
+  const int64_t r2 = int64_t(radius) * radius + radius;
+  int halfWidth = radius;
+  for(int dy = 1; dy<=radius; dy++) {
+    while(halfWidth > 0 && int64_t(halfWidth) * halfWidth + int64_t(dy) * dy > r2)
+      --halfWidth;
+    const int inset = radius - halfWidth;
+    const int x0 = x + inset;
+    const int x1 = x + width - 1 - inset;
+    FillSpan(y + radius - dy, x0, x1, color);
+    FillSpan(y + height - 1 - radius + dy, x0, x1, color);
   }
 }
 
+bool FBDisplay::ClipToScreen(int& xpos, int& ypos, int& width, int& height, int& skipX, int& skipY) const
+{
+  skipX = std::max(0, -xpos);
+  skipY = std::max(0, -ypos);
+  xpos += skipX;
+  ypos += skipY;
+  width = std::min(width - skipX, m_screenWidth - xpos);
+  height = std::min(height - skipY, m_screenHeight - ypos);
+  return width > 0 && height > 0;
+}
+
+void FBDisplay::CompositeImage(const uint32_t *src, int srcStride, int width, int height, int xpos, int ypos, int alpha)
+{
+  int skipX, skipY;
+  if(alpha <= 0 || !ClipToScreen(xpos, ypos, width, height, skipX, skipY))
+    return;
+  MarkContent(FBRect{xpos, ypos, width, height});
+
+  const char *srcRow = (const char *)src + (skipY * srcStride) + (skipX * 4);
+  for(int y = 0; y<height; y++) {
+    uint32_t *dst = (uint32_t *)(m_fbp + ((ypos + y) * m_stride)) + xpos;
+    CompositeSpanOverAlpha(dst, (const uint32_t *)srcRow, width, alpha);
+    srcRow += srcStride;
+  }
+}
+
+void FBDisplay::CompositeFill(int x, int y, int width, int height, uint32_t color)
+{
+  int skipX, skipY;
+  if(!ClipToScreen(x, y, width, height, skipX, skipY))
+    return;
+  MarkContent(FBRect{x, y, width, height});
+
+  const uint32_t premultiplied = PremultiplyColor(color);
+  for(int row = 0; row<height; row++)
+    CompositeSpanFill((uint32_t *)(m_fbp + ((y + row) * m_stride)) + x, width, premultiplied);
+}
+
+void FBDisplay::CompositeMask(const uint8_t *mask, int maskStride, int width, int height, int xpos, int ypos, uint32_t color)
+{
+  int skipX, skipY;
+  if(!ClipToScreen(xpos, ypos, width, height, skipX, skipY))
+    return;
+  MarkContent(FBRect{xpos, ypos, width, height});
+
+  const uint32_t premultiplied = PremultiplyColor(color);
+  const uint8_t *maskRow = mask + (skipY * maskStride) + skipX;
+  for(int y = 0; y<height; y++) {
+    uint32_t *dst = (uint32_t *)(m_fbp + ((ypos + y) * m_stride)) + xpos;
+    CompositeSpanMask(dst, maskRow, width, premultiplied);
+    maskRow += maskStride;
+  }
+}
+
+void FBDisplay::MarkContent(const FBRect& rect)
+{
+  const FBRect clipped = rect.Intersect(GetScreenRect());
+  m_content.Add(clipped);
+  m_damage.Add(clipped);
+}
+
 void FBDisplay::Clear()
 {
-  constexpr int clearcolor = 0xff000000;
-  int *fptr = (int *)m_fbp;
-  int *endPtr = fptr + (m_screenHeight * m_screenWidth);
-  while(fptr < endPtr)
-    *fptr++ = clearcolor;
+  for(int n = 0; n<m_content.GetCount(); n++) {
+    FillRows(m_content[n], ClearColor);
+    m_damage.Add(m_content[n]);
+  }
+  m_content.Reset();
+}
+
+void FBDisplay::Clear(const FBRect& rect)
+{
+  const FBRect clipped = rect.Intersect(GetScreenRect());
+  if(clipped.IsEmpty())
+    return;
+  
+  FillRows(clipped, ClearColor);
+  m_content.RemoveInside(clipped);
+  m_damage.Add(clipped);
 }
 
 void FBDisplay::Present()
 {
-  if(m_bpp == 32) 
-    memcpy(m_realFbp, m_fbp, (m_screenHeight * m_screenWidth * m_bpp) / 8);
-  else if(m_bpp == 16) {
-    const int width = m_screenWidth;
-    const int height = m_screenHeight;
-    
-    const unsigned char *src = (const unsigned char *)m_fbp;
-    uint16_t *dst = (uint16_t *)m_realFbp;    
-    
-    // we are foolishly ignoring any stride here.
-    for(int y = 0; y<height; y++) {
-      uint16_t *dstRow = dst + (y * width);
-      const unsigned char *srcRow = src + (y * width * 4);
-      for(int x = 0; x<width; x++) {	
-	const uint16_t r = (srcRow[2] >> 3) << SHIFT_R;
-	const uint16_t g = (srcRow[1] >> 2) << SHIFT_G;
-	const uint16_t b = (srcRow[0] >> 3) << SHIFT_B;
-	srcRow += 4;
-	*dstRow++ = (r | g | b);
-      }
-    }    
+  QT_SCOPED_TIMER(TIMER_PRESENT);
+  for(int n = 0; n<m_damage.GetCount(); n++)
+    PresentPageLayer(m_damage[n]);
+  m_damage.Reset();
+}
+
+void FBDisplay::PresentAll()
+{
+  QT_SCOPED_TIMER(TIMER_PRESENT);
+  PresentPageLayer(GetScreenRect());
+  m_damage.Reset();
+}
+
+void FBDisplay::PresentPageLayer(const FBRect& rect)
+{
+  FBRect visible[4];
+  const int count = rect.Subtract(m_videoLayer, visible);
+  for(int n = 0; n<count; n++)
+    PresentRect(visible[n]);
+}
+
+void FBDisplay::PresentRect(const FBRect& rect)
+{
+  m_workers->Run(rect.m_height, rect.m_width, [&](int first, int end) {
+    PresentBand(FBRect{rect.m_x, rect.m_y + first, rect.m_width, end - first});
+  });
+}
+
+void FBDisplay::PresentBand(const FBRect& rect)
+{
+  const char *src = m_fbp + (rect.m_y * m_stride) + (rect.m_x * 4);
+  char *dst = m_realFbp + (rect.m_y * m_frontStride) + (rect.m_x * (m_bpp / 8));
+  for(int y = 0; y<rect.m_height; y++) {
+    m_pixelKernels->m_fromARGB(dst, (const uint32_t *)src, rect.m_width);
+    src += m_stride;
+    dst += m_frontStride;
   }
 }
 
-bool FBDisplay::Open()
+bool FBDisplayConfig::Parse(const char *spec)
+{
+  char path[256];
+  if(sscanf(spec, "memory:%ix%ix%i:%i", &m_width, &m_height, &m_bpp, &m_stride) >= 3) {
+    m_backend = MEMORY;
+    return true;
+  }
+  if(sscanf(spec, "file:%255[^:]:%ix%ix%i:%i", path, &m_width, &m_height, &m_bpp, &m_stride) >= 4) {
+    m_backend = FILE;
+    m_path = path;
+    return true;
+  }
+  if(strncmp(spec, "device:", 7) == 0 && spec[7]) {
+    m_backend = DEVICE;
+    m_path = spec + 7;
+    return true;
+  }
+  printf("Bad display spec: '%s'\n", spec);
+  return false;
+}
+
+bool FBDisplayConfig::IsSizeValid() const
+{
+  constexpr int MaxSide = 16384;
+  constexpr uint64_t MaxBytes = 0x7fffffff;
+  const uint64_t rowBytes = (uint64_t)m_width * m_bpp / 8;
+  // the back buffer is always 32bpp, so it is at least as big as the front one.
+  if(m_width <= 0 || m_height <= 0 || m_width > MaxSide || m_height > MaxSide || (m_bpp != 16 && m_bpp != 32) ||
+     m_stride < 0 || (m_stride && (uint64_t)m_stride < rowBytes) ||
+     (uint64_t)m_width * m_height * 4 > MaxBytes || (uint64_t)(m_stride ? m_stride : rowBytes) * m_height > MaxBytes) {
+    printf("Bad framebuffer size %i x %i x %i stride %i\n", m_width, m_height, m_bpp, m_stride);
+    return false;
+  }
+  return true;
+}
+
+bool FBDisplay::OpenDevice()
 {
   // Open the framebuffer device file for reading and writing
-  m_fbfd = open("/dev/fb0", O_RDWR);
+  m_fbfd = open(m_config.m_path.c_str(), O_RDWR);
   if (m_fbfd == -1) {
     printf("Error: cannot open framebuffer device.\n");
     return false;
@@ -242,13 +733,8 @@ bool FBDisplay::Open()
   m_screenHeight = vinfo.yres;
   m_screenWidth = vinfo.xres;
   m_bpp = vinfo.bits_per_pixel;
-  m_stride = m_screenWidth * 4;//finfo.line_length;
-
-
-  if(!(vinfo.bits_per_pixel == 32 || vinfo.bits_per_pixel == 16)) {
-    printf("Only supporting 32bpp or 16bpp\n");
-    return false;
-  }
+  m_frontStride = finfo.line_length;
+  m_pixelKernels = FindPixelKernels(vinfo.bits_per_pixel, vinfo.red.offset, vinfo.transp.length > 0);
   
   // map framebuffer to user memory 
   m_screensize = finfo.smem_len;
@@ -261,41 +747,313 @@ bool FBDisplay::Open()
   
   if (m_realFbp == (char *)-1) {
     printf("Failed to mmap.\n");
+    m_realFbp = nullptr;
+    return false;
+  }
+
+  return true;
+}
+
+bool FBDisplay::OpenMemory()
+{
+  if(!m_config.IsSizeValid())
+    return false;
+  m_screenWidth = m_config.m_width;
+  m_screenHeight = m_config.m_height;
+  m_bpp = m_config.m_bpp;
+  m_frontStride = m_config.m_stride ? m_config.m_stride : (m_screenWidth * m_bpp) / 8;
+  m_pixelKernels = FindPixelKernels(m_bpp, m_bpp == 16 ? 11 : 16, false);
+  
+  m_memFbp.assign((size_t)m_frontStride * m_screenHeight, 0);
+  m_realFbp = &m_memFbp[0];
+  printf("Memory framebuffer %i x %i x %i\n", m_screenWidth, m_screenHeight, m_bpp);
+  return true;
+}
+
+bool FBDisplay::OpenFile()
+{
+  if(!m_config.IsSizeValid())
+    return false;
+  m_screenWidth = m_config.m_width;
+  m_screenHeight = m_config.m_height;
+  m_bpp = m_config.m_bpp;
+  m_frontStride = m_config.m_stride ? m_config.m_stride : (m_screenWidth * m_bpp) / 8;
+  m_screensize = (long int)m_frontStride * m_screenHeight;
+  m_pixelKernels = FindPixelKernels(m_bpp, m_bpp == 16 ? 11 : 16, false);
+
+  m_fbfd = open(m_config.m_path.c_str(), O_RDWR | O_CREAT, 0644);
+  if(m_fbfd == -1) {
+    printf("Error: cannot open framebuffer file '%s'.\n", m_config.m_path.c_str());
+    return false;
+  }
+
+  if(ftruncate(m_fbfd, m_screensize) != 0) {
+    printf("Failed to size framebuffer file.\n");
+    return false;
+  }
+  
+  m_realFbp = (char*)mmap(0, m_screensize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fbfd, 0);
+  if (m_realFbp == (char *)-1) {
+    printf("Failed to mmap.\n");
+    m_realFbp = nullptr;
+    return false;
+  }
+  
+  printf("File framebuffer '%s' %i x %i x %i\n", m_config.m_path.c_str(), m_screenWidth, m_screenHeight, m_bpp);
+  return true;
+}
+
+bool FBDisplay::Open()
+{
+  bool ok = false;
+  switch(m_config.m_backend) {
+  case FBDisplayConfig::DEVICE:
+    ok = OpenDevice();
+    break;
+  case FBDisplayConfig::MEMORY:
+    ok = OpenMemory();
+    break;
+  case FBDisplayConfig::FILE:
+    ok = OpenFile();
+    break;
+  }
+  
+  if(!ok) {
+    Close();
     return false;
   }
 
-  m_tmpFbp.resize(m_screenWidth * m_screenHeight * 4);
+  if(!m_pixelKernels || m_frontStride < (m_screenWidth * m_bpp) / 8) {
+    printf("Unsupported %ibpp pixel layout\n", m_bpp);
+    Close();
+    return false;
+  }
+  
+  m_stride = m_screenWidth * 4;
+  m_tmpFbp.resize((size_t)m_screenWidth * m_screenHeight * 4);
   m_fbp = &m_tmpFbp[0];
 
-  Clear();
-  usleep(MICROS / 10);
-  Clear();
+  if(!m_workers) {
+    m_workers = new BandWorkers;
+    m_workers->Start(m_config.m_threads);
+  }
+  printf("Presenting as %s with %i threads\n", m_pixelKernels->m_name, m_workers->GetThreadCount());
 
+  // whatever was on the screen before is unknown so the first clear and present cover all of it.
+  m_damage.Reset();
+  m_content.Reset();
+  m_content.Add(GetScreenRect());
+  Clear();
   return true;
 }
 
 void FBDisplay::Close()
 {
-  if(m_realFbp)
+  if(m_splashThread.joinable())
+    m_splashThread.join();
+  SetBlanked(false);
+  if(m_realFbp && m_screensize)
     munmap(m_realFbp, m_screensize);
-  if(m_fbfd)
+  m_realFbp = nullptr;
+  m_screensize = 0;
+  if(m_fbfd >= 0)
     close(m_fbfd);
+  m_fbfd = -1;
+  m_fbp = nullptr;
+  m_pixelKernels = nullptr;
+  delete m_workers;
+  m_workers = nullptr;
+}
+
+void FBDisplay::SetWorkerPlacement(const ThreadPlacement& placement)
+{
+  if(m_workers)
+    m_workers->SetPlacement(placement);
+}
+
+void FBDisplay::LockBuffers()
+{
+  m_lockBuffers = true;
+  LockMemory(m_fbp, m_tmpFbp.size(), "back buffer");
+  if(!m_memFbp.empty())
+    LockMemory(&m_memFbp[0], m_memFbp.size(), "front buffer");
+}
+
+bool FBDisplay::SetBlanked(bool blanked)
+{
+  if(blanked == m_blanked)
+    return true;
+  
+  if(m_config.m_backend == FBDisplayConfig::DEVICE && m_fbfd >= 0) {
+    if(ioctl(m_fbfd, FBIOBLANK, blanked ? FB_BLANK_POWERDOWN : FB_BLANK_UNBLANK) != 0) {
+      printf("Failed to %s the display\n", blanked ? "blank" : "unblank");
+      return false;
+    }
+  }
+  m_blanked = blanked;
+  return true;
+}
+
+namespace {
+/// starts a splash file, the pixels follow row after row with no padding.
+struct SplashHeader {
+  char m_magic[4];
+  int32_t m_width;
+  int32_t m_height;
+  int32_t m_format;
+};
+constexpr char SplashMagic[4] = {'Q', 'T', 'S', 'P'};
+}
+
+bool FBDisplay::ShowSplash(const char *path)
+{
+  if(!m_realFbp || !m_pixelKernels)
+    return false;
+  
+  const int fd = open(path, O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  const size_t rowBytes = (m_screenWidth * m_bpp) / 8;
+  const size_t size = sizeof(SplashHeader) + (rowBytes * m_screenHeight);
+  struct stat st;
+  if(fstat(fd, &st) != 0 || size_t(st.st_size) != size) {
+    printf("Ignoring splash '%s', it isn't for a %i x %i x %i screen\n", path, m_screenWidth, m_screenHeight, m_bpp);
+    close(fd);
+    return false;
+  }
+  
+  void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(data == MAP_FAILED)
+    return false;
+
+  const SplashHeader *header = (const SplashHeader *)data;
+  const bool matches = memcmp(header->m_magic, SplashMagic, sizeof(SplashMagic)) == 0 &&
+    header->m_width == m_screenWidth && header->m_height == m_screenHeight && header->m_format == m_pixelKernels->m_format;
+  if(matches) {
+    const char *src = (const char *)(header + 1);
+    char *dst = m_realFbp;
+    for(int y = 0; y<m_screenHeight; y++) {
+      memcpy(dst, src, rowBytes);
+      src += rowBytes;
+      dst += m_frontStride;
+    }
+  } else {
+    printf("Ignoring splash '%s', it is for another screen\n", path);
+  }
+  munmap(data, size);
+  return matches;
+}
+
+void FBDisplay::SaveSplash(const char *path)
+{
+  if(!m_realFbp || !m_pixelKernels)
+    return;
+  if(m_splashThread.joinable())
+    m_splashThread.join();
+  
+  const size_t rowBytes = (m_screenWidth * m_bpp) / 8;
+  std::vector<char> image(sizeof(SplashHeader) + (rowBytes * m_screenHeight));
+  SplashHeader header;
+  memcpy(header.m_magic, SplashMagic, sizeof(SplashMagic));
+  header.m_width = m_screenWidth;
+  header.m_height = m_screenHeight;
+  header.m_format = m_pixelKernels->m_format;
+  memcpy(&image[0], &header, sizeof(header));
+  char *dst = &image[sizeof(header)];
+  const char *src = m_realFbp;
+  for(int y = 0; y<m_screenHeight; y++) {
+    memcpy(dst, src, rowBytes);
+    dst += rowBytes;
+    src += m_frontStride;
+  }
+
+  // the write runs alongside the main loop rather than on its core.
+  ScopedUnplacedThread unplaced;
+  m_splashThread = std::thread([image = std::move(image), file = std::string(path)]() {
+    // written to the side and renamed over the old one so losing power part way never leaves half a splash.
+    const std::string tmpFile = file + ".tmp";
+    FILE *f = fopen(tmpFile.c_str(), "wb");
+    if(!f) {
+      printf("Failed to write splash '%s'\n", tmpFile.c_str());
+      return;
+    }
+    bool ok = fwrite(&image[0], 1, image.size(), f) == image.size();
+    ok = fflush(f) == 0 && ok;
+    ok = fsync(fileno(f)) == 0 && ok;
+    ok = fclose(f) == 0 && ok;
+    if(!ok || rename(tmpFile.c_str(), file.c_str()) != 0) {
+      printf("Failed to write splash '%s'\n", file.c_str());
+      unlink(tmpFile.c_str());
+      return;
+    }
+    printf("Saved splash '%s'\n", file.c_str());
+  });
+}
+
+struct VLCImpl {
+  libvlc_instance_t *libvlc = nullptr;
+  libvlc_media_player_t *mp = nullptr;
+  /// drives mp through a playlist, null for a single video.
+  libvlc_media_list_player_t *mlp = nullptr;
+};
+
+unsigned FBDisplay::vlcSetup(char *chroma, unsigned *width, unsigned *height, unsigned *pitches, unsigned *lines)
+{
+  // libvlc scales to whatever size is asked for, the planes were allocated before playing.
+  memcpy(chroma, "I420", 4);
+  *width = m_videoWidth;
+  *height = m_videoHeight;
+  pitches[0] = m_videoWidth;
+  pitches[1] = pitches[2] = m_videoWidth / 2;
+  lines[0] = m_videoHeight;
+  lines[1] = lines[2] = m_videoHeight / 2;
+  return 1;
 }
 
 void FBDisplay::vlcLock(void **pPixels)
 {
+  if(m_playingYUV) {
+    pPixels[0] = m_vlcPlanes;
+    pPixels[1] = m_vlcPlanes + (m_videoWidth * m_videoHeight);
+    pPixels[2] = m_vlcPlanes + (m_videoWidth * m_videoHeight) + ((m_videoWidth / 2) * (m_videoHeight / 2));
+    return;
+  }
   *pPixels = m_vlcPixels;
 }
 
 void FBDisplay::vlcUnlock(const uint16_t *pixels)
 {
+  // I420 frames are converted straight from where they were decoded.
+  m_videoDecoded.fetch_add(1, std::memory_order_relaxed);
+  if(m_playingYUV)
+    return;
   memcpy(m_vlcFrame, pixels, m_videoWidth * m_videoHeight * sizeof(uint16_t));
 }
 
 void FBDisplay::vlcDisplay()
 {
+  constexpr int64_t DefaultPeriod = 1000000 / 25;
+  if(!m_videoPlaced) {
+    m_videoPlaced = true;
+    ApplyThreadPlacement(m_videoPlacement, "video output thread");
+  }
+  
+  const int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  if(m_videoRetime.exchange(false, std::memory_order_relaxed) || !m_videoPacer.IsTimed()) {
+    const float fps = libvlc_media_player_get_fps(m_vlcImpl->mp);
+    m_videoPacer.Retime(fps > 1.0f ? int64_t(1000000 / fps) : DefaultPeriod, now);
+  }
+  if(m_videoPacer.DropFrame(now)) {
+    m_videoDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  
   const int ypos = m_videoWindowY;
-  if(true || GetScreenHeight() >= 1024) {
+  if(m_playingYUV) {
+    BlitYUVDoubleScale(m_vlcPlanes, m_videoWidth, m_videoHeight, (GetScreenWidth() - (m_videoWidth * 2)) / 2, ypos);
+  } else if(true || GetScreenHeight() >= 1024) {
     const int xpos = (GetScreenWidth() - (m_videoWidth * 2)) / 2;        
     BlitImage16BitColorDoubleScale(m_vlcFrame, m_videoWidth, m_videoHeight, xpos, ypos);
   } else {
@@ -303,24 +1061,52 @@ void FBDisplay::vlcDisplay()
     BlitImage16BitColor(m_vlcFrame, m_videoWidth, m_videoHeight, xpos, ypos);
   }
   
-  m_videoFrameObserver();
+  const int64_t done = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  m_videoBlitMicros.fetch_add(done - now, std::memory_order_relaxed);
+  m_videoDisplayed.fetch_add(1, std::memory_order_relaxed);
+  m_videoFrameCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+VideoStats FBDisplay::GetVideoStats() const
+{
+  VideoStats stats;
+  stats.m_decoded = m_videoDecoded.load(std::memory_order_relaxed);
+  stats.m_displayed = m_videoDisplayed.load(std::memory_order_relaxed);
+  stats.m_dropped = m_videoDropped.load(std::memory_order_relaxed);
+  if(stats.m_displayed)
+    stats.m_averageBlitMs = m_videoBlitMicros.load(std::memory_order_relaxed) / (1000.0 * stats.m_displayed);
+  return stats;
+}
+
+FBRect FBDisplay::GetVideoRect() const
+{
+  return FBRect{(GetScreenWidth() - (m_videoWidth * 2)) / 2, m_videoWindowY, m_videoWidth * 2, m_videoHeight * 2};
 }
 
 void FBDisplay::vlcStopEvent()
 {
   printf("Stop event\n");
-  m_videoStopObserver();
+  m_videoStopObserver(GetVideoStats());
 }
 
-struct VLCImpl {
-  libvlc_instance_t *libvlc = nullptr;
-  libvlc_media_player_t *mp = nullptr;
-};
+void FBDisplay::StartVideoInit()
+{
+  if(m_vlcImpl || m_videoInitThread.joinable())
+    return;
 
-bool FBDisplay::VideoPlay(const char *filename)
+  // the thread only ever fills in libvlc, everything else stays on the main thread.
+  m_vlcImpl = new VLCImpl;
+  m_videoInitThread = std::thread([this]() {
+    const auto start = std::chrono::steady_clock::now();
+    if(VideoInit()) {
+      const std::chrono::duration<double, std::milli> delta = std::chrono::steady_clock::now() - start;
+      printf("LibVLC ready in %.0fms\n", delta.count());
+    }
+  });
+}
+
+bool FBDisplay::VideoInit()
 {
-  VideoStop();
-  
   char const *vlc_argv[] = {
     "--no-xlib" // Don't use Xlib.
     //   "--alsa-audio-device", "hw:1,0",
@@ -338,6 +1124,36 @@ bool FBDisplay::VideoPlay(const char *filename)
       return false;
     }
   }
+  return true;
+}
+
+void FBDisplay::WaitVideoInit()
+{
+  if(m_videoInitThread.joinable())
+    m_videoInitThread.join();
+}
+
+void FBDisplay::VideoShutdown()
+{
+  WaitVideoInit();
+  VideoStop();
+  if(!m_vlcImpl)
+    return;
+  
+  if(m_vlcImpl->libvlc)
+    libvlc_release(m_vlcImpl->libvlc);
+  delete m_vlcImpl;
+  m_vlcImpl = nullptr;
+}
+
+bool FBDisplay::VideoPlay(const char *filename)
+{
+  VideoStop();
+  WaitVideoInit();
+  if(!VideoInit())
+    return false;
+  // libvlc starts its input, decoder and output threads from here, they mustn't inherit the main loop's placement.
+  ScopedUnplacedThread unplaced;
 
   libvlc_media_t *m = libvlc_media_new_path(m_vlcImpl->libvlc, filename);
   if(m == nullptr) {
@@ -353,36 +1169,163 @@ bool FBDisplay::VideoPlay(const char *filename)
     
   libvlc_media_release(m);
 
-  if(!m_vlcFrame)
-    m_vlcFrame = new uint16_t[m_videoHeight * m_videoWidth];
-  if(!m_vlcPixels)
-    m_vlcPixels = new uint16_t[m_videoHeight * m_videoWidth];
-
-  libvlc_event_manager_t *eventManager = libvlc_media_player_event_manager(m_vlcImpl->mp);
-  libvlc_event_attach(eventManager, libvlc_MediaPlayerStopped, VLCCallbacks::stopEvent, this);
-  libvlc_video_set_callbacks(m_vlcImpl->mp, VLCCallbacks::lock, VLCCallbacks::unlock, VLCCallbacks::display, this);
-  libvlc_video_set_format(m_vlcImpl->mp, "RV16", m_videoWidth, m_videoHeight, m_videoWidth * sizeof(uint16_t));
+  AttachVideoPlayer(true);
   libvlc_media_player_play(m_vlcImpl->mp);
+  return true;
+}
+
+bool FBDisplay::VideoPlayList(const std::vector<std::string>& filenames)
+{
+  VideoStop();
+  WaitVideoInit();
+  if(!VideoInit())
+    return false;
+  // the preparser, the list player's thread and everything they start mustn't inherit the main loop's placement.
+  ScopedUnplacedThread unplaced;
+
+  libvlc_media_list_t *list = libvlc_media_list_new(m_vlcImpl->libvlc);
+  if(list == nullptr) {
+    printf("media list new fails\n");
+    return false;
+  }
+
+  int count = 0;
+  for(const auto& filename : filenames) {
+    // libvlc takes any path and only finds out later, so a list of missing files would play nothing forever.
+    if(access(filename.c_str(), R_OK) != 0) {
+      printf("Can't read video '%s'\n", filename.c_str());
+      continue;
+    }
+    libvlc_media_t *m = libvlc_media_new_path(m_vlcImpl->libvlc, filename.c_str());
+    if(m == nullptr) {
+      printf("media new path fails for '%s'\n", filename.c_str());
+      continue;
+    }
+    // a lone clip goes round inside the one input, which keeps its demuxer and decoders running.
+    if(filenames.size() == 1)
+      libvlc_media_add_option(m, ":input-repeat=65535");
+    // probing each clip up front means moving on to it later doesn't have to.
+    libvlc_media_parse_with_options(m, libvlc_media_parse_local, -1);
+    libvlc_media_list_add_media(list, m);
+    libvlc_media_release(m);
+    ++count;
+  }
+
+  if(count == 0) {
+    libvlc_media_list_release(list);
+    return false;
+  }
+
+  m_vlcImpl->mp = libvlc_media_player_new(m_vlcImpl->libvlc);
+  m_vlcImpl->mlp = libvlc_media_list_player_new(m_vlcImpl->libvlc);
+  if(m_vlcImpl->mp == nullptr || m_vlcImpl->mlp == nullptr) {
+    printf("media list player new fails\n");
+    libvlc_media_list_release(list);
+    VideoStop();
+    return false;
+  }
+
+  // the one player, with its callbacks and output format, is kept for every clip.
+  libvlc_media_list_player_set_media_player(m_vlcImpl->mlp, m_vlcImpl->mp);
+  libvlc_media_list_player_set_media_list(m_vlcImpl->mlp, list);
+  libvlc_media_list_release(list);
+  libvlc_media_list_player_set_playback_mode(m_vlcImpl->mlp, libvlc_playback_mode_loop);
 
+  AttachVideoPlayer(false);
+  libvlc_event_attach(libvlc_media_player_event_manager(m_vlcImpl->mp), libvlc_MediaPlayerMediaChanged, VLCCallbacks::mediaChanged, this);
+  printf("Looping %i videos\n", count);
+  libvlc_media_list_player_play(m_vlcImpl->mlp);
   return true;
 }
 
+void FBDisplay::AttachVideoPlayer(bool notifyStop)
+{
+  m_playingYUV = m_videoYUV;
+  m_videoDecoded = 0;
+  m_videoDisplayed = 0;
+  m_videoDropped = 0;
+  m_videoBlitMicros = 0;
+  m_videoPacer.Reset();
+  m_videoRetime = false;
+  m_videoPlaced = m_videoPlacement.IsDefault();
+  const size_t frameSize = m_videoHeight * m_videoWidth;
+  if(m_playingYUV) {
+    if(!m_vlcPlanes) {
+      m_vlcPlanes = new uint8_t[(frameSize * 3) / 2];
+      if(m_lockBuffers)
+	LockMemory(m_vlcPlanes, (frameSize * 3) / 2, "video planes");
+    }
+  } else {
+    if(!m_vlcFrame) {
+      m_vlcFrame = new uint16_t[frameSize];
+      if(m_lockBuffers)
+	LockMemory(m_vlcFrame, frameSize * sizeof(uint16_t), "video frame");
+    }
+    if(!m_vlcPixels) {
+      m_vlcPixels = new uint16_t[frameSize];
+      if(m_lockBuffers)
+	LockMemory(m_vlcPixels, frameSize * sizeof(uint16_t), "video frame");
+    }
+  }
+
+  if(notifyStop) {
+    libvlc_event_manager_t *eventManager = libvlc_media_player_event_manager(m_vlcImpl->mp);
+    libvlc_event_attach(eventManager, libvlc_MediaPlayerStopped, VLCCallbacks::stopEvent, this);
+  }
+  libvlc_video_set_callbacks(m_vlcImpl->mp, VLCCallbacks::lock, VLCCallbacks::unlock, VLCCallbacks::display, this);
+  if(m_playingYUV) {
+    libvlc_video_set_format_callbacks(m_vlcImpl->mp, VLCCallbacks::setup, VLCCallbacks::cleanup);
+    printf("Playing video as I420 with the %s converter\n", YUVKernelName());
+  } else {
+    libvlc_video_set_format(m_vlcImpl->mp, "RV16", m_videoWidth, m_videoHeight, m_videoWidth * sizeof(uint16_t));
+  }
+  m_videoLayer = GetVideoRect().Intersect(GetScreenRect());
+}
+
+bool FBDisplay::IsVideoPlaying() const
+{
+  return m_vlcImpl && m_vlcImpl->mp;
+}
+
+bool FBDisplay::IsVideoLooping() const
+{
+  return m_vlcImpl && m_vlcImpl->mlp;
+}
+
 void FBDisplay::VideoStop()
 {
   if(!m_vlcImpl)
     return;
 
+  if(m_vlcImpl->mlp) {
+    libvlc_media_list_player_stop(m_vlcImpl->mlp);
+    libvlc_media_list_player_release(m_vlcImpl->mlp);
+    m_vlcImpl->mlp = nullptr;
+  }
+
   if(m_vlcImpl->mp) {
     libvlc_media_player_stop(m_vlcImpl->mp);
     libvlc_media_player_release(m_vlcImpl->mp);
     m_vlcImpl->mp = nullptr;
+
+    const VideoStats stats = GetVideoStats();
+    printf("Video stopped: %u decoded, %u displayed, %u dropped, %.2fms average blit\n",
+	   stats.m_decoded, stats.m_displayed, stats.m_dropped, stats.m_averageBlitMs);
   }
 
-  if(m_vlcImpl->libvlc) {
-    libvlc_release(m_vlcImpl->libvlc);
-    m_vlcImpl->libvlc = nullptr;
+  // the page underneath was never drawn over so presenting it is all it takes to put it back.
+  if(!m_videoLayer.IsEmpty()) {
+    m_damage.Add(m_videoLayer);
+    m_videoLayer = FBRect();
   }
 
+  const size_t frameSize = m_videoHeight * m_videoWidth;
+  if(m_lockBuffers) {
+    UnlockMemory(m_vlcPixels, frameSize * sizeof(uint16_t));
+    UnlockMemory(m_vlcFrame, frameSize * sizeof(uint16_t));
+    UnlockMemory(m_vlcPlanes, (frameSize * 3) / 2);
+  }
+  
   if(m_vlcPixels) {
     delete m_vlcPixels;
     m_vlcPixels = nullptr;
@@ -392,5 +1335,8 @@ void FBDisplay::VideoStop()
     delete m_vlcFrame;
     m_vlcFrame = nullptr;
   }
+
+  delete [] m_vlcPlanes;
+  m_vlcPlanes = nullptr;
 }
 
@@ -9,50 +9,187 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 */																																																	  
 #pragma once
 
+/// Where FBDisplay's front buffer lives. The memory and file backends let the whole app run
+/// on machines without a framebuffer, for benchmarking and testing.
+struct FBDisplayConfig {
+  enum Backend {
+    DEVICE,	///< a real framebuffer device, /dev/fb0 by default
+    MEMORY,	///< a plain block of memory of the given size
+    FILE	///< a file of the given size mapped like a framebuffer device, which other tools can watch
+  };
+
+  Backend m_backend = DEVICE;
+  std::string m_path = "/dev/fb0";
+  int m_width = 800;
+  int m_height = 600;
+  int m_bpp = 32;
+  /// bytes per row, zero for tightly packed rows.
+  int m_stride = 0;
+  /// threads sharing large presents and clears, counting the main thread. Zero means one per core.
+  int m_threads = 0;
+
+  /// parses 'device:/dev/fbN', 'memory:WxHxBPP[:stride]' or 'file:path:WxHxBPP[:stride]'.
+  bool Parse(const char *spec);
+  /// checks the size the memory and file backends use is something that can be allocated and
+  /// addressed with int offsets, printing why not.
+  bool IsSizeValid() const;
+};
+
+/// A rectangle of screen pixels, empty when either size is zero or less.
+struct FBRect {
+  int m_x = 0;
+  int m_y = 0;
+  int m_width = 0;
+  int m_height = 0;
+
+  bool IsEmpty() const { return m_width <= 0 || m_height <= 0; }
+  int GetArea() const { return IsEmpty() ? 0 : m_width * m_height; }
+  bool Contains(const FBRect& other) const;
+  FBRect Union(const FBRect& other) const;
+  FBRect Intersect(const FBRect& other) const;
+  /// splits what is left of this once 'other' is taken away into up to four rectangles, returning how many.
+  int Subtract(const FBRect& other, FBRect out[4]) const;
+};
+
+/// An area of the screen kept as a short list of rectangles, which may overlap. Once the list is full
+/// new rectangles are merged into whichever existing one grows the least, so it only ever over covers.
+class FBRegion {
+public:
+  void Add(const FBRect& rect);
+  /// drops the rectangles entirely inside 'rect', the others are kept whole.
+  void RemoveInside(const FBRect& rect);
+  void Reset() { m_count = 0; }
+
+  bool IsEmpty() const { return m_count == 0; }
+  int GetCount() const { return m_count; }
+  const FBRect& operator[](int n) const { return m_rects[n]; }
+
+private:
+  static constexpr int MaxRects = 16;
+  FBRect m_rects[MaxRects];
+  int m_count = 0;
+};
+
+/// How the video playing, or the last one played, kept up.
+struct VideoStats {
+  unsigned m_decoded = 0;
+  unsigned m_displayed = 0;
+  /// frames which arrived too late and were skipped rather than converted and blitted.
+  unsigned m_dropped = 0;
+  double m_averageBlitMs = 0.0;
+};
+
 class FBDisplay {
 public:
   FBDisplay() { }
-  ~FBDisplay() { Close(); }
+  ~FBDisplay() { VideoShutdown(); Close(); }
 
   bool IsOpen() const { return m_fbp != NULL; }
+
+  /// chooses the backend used by the next Open.
+  void SetConfig(const FBDisplayConfig& config) { m_config = config; }
   
   bool Open();
   void Close();
+  /// clears the parts of the back buffer anything has been drawn into since they were last cleared.
   void Clear();
+  void Clear(const FBRect& rect);
+  /// copies the parts of the back buffer changed since the last Present to the screen. The back
+  /// buffer is the page layer, while a video plays its rectangle belongs to the video layer and is
+  /// left alone.
   void Present();
+  void PresentAll();
+  /// the FBDisplay drawing calls keep track of what they touch, anything else writing to the back
+  /// buffer, such as cairo, needs to say where it drew for Clear and Present to pick it up.
+  void MarkContent(const FBRect& rect);
 
   void PutPixel(int x, int y, int color);
   void PlotLine(int x0, int y0, int x1, int y1, int color);
+  /// circle and ellipse outlines, centred on x, y.
   void DrawCircle(int x, int y, int radius, int color);
   void DrawEllipse(int x, int y, int radiusX, int radiusY, int color);
+  /// the fills clip once and then write whole rows, they don't blend.
+  void FillRect(int x, int y, int width, int height, int color);
+  void FillCircle(int x, int y, int radius, int color);
+  void FillEllipse(int x, int y, int radiusX, int radiusY, int color);
+  void FillRoundedRect(int x, int y, int width, int height, int radius, int color);
+  /// blends premultiplied ARGB32 pixels, like a cairo image surface's, into the back buffer faded
+  /// by 'alpha' (0-255). 'srcStride' is in bytes.
+  void CompositeImage(const uint32_t *src, int srcStride, int width, int height, int xpos, int ypos, int alpha = 255);
+  /// blends a straight alpha 0xAARRGGBB colour over a rectangle.
+  void CompositeFill(int x, int y, int width, int height, uint32_t color);
+  /// blends a straight alpha colour through an 8bit coverage mask, such as a glyph.
+  void CompositeMask(const uint8_t *mask, int maskStride, int width, int height, int xpos, int ypos, uint32_t color);
   void BlitImage16BitColorDoubleScale(const uint16_t *src, int width, int height, int xpos, int ypos);
+  /// converts an I420 frame doubled in size into the front buffer, clipping it to the screen.
+  void BlitYUVDoubleScale(const uint8_t *planes, int width, int height, int xpos, int ypos);
   void BlitImage16BitColor(const uint16_t *src, int width, int height, int xpos, int ypos);    
+  /// copies 32bit pixels into the back buffer, 'srcStride' is in bytes.
+  void BlitImage32BitColor(const uint32_t *src, int srcStride, int width, int height, int xpos, int ypos);
+  /// moves the rows of a region of the back buffer up by 'dy' (or down if negative), the rows
+  /// uncovered at the other end are left as they were for the caller to fill.
+  void ScrollRegion(int x, int y, int width, int height, int dy);
 
   int GetScreenWidth() const { return m_screenWidth; }
   int GetScreenHeight() const { return m_screenHeight; }
+  FBRect GetScreenRect() const { return FBRect{0, 0, m_screenWidth, m_screenHeight}; }
 
   void SetTextColor(const int c) { m_textColor = c; }
 
   char *GetSurfacePtr() { return m_fbp; }
   int GetStride() const { return m_stride; }
+  int GetBitsPerPixel() const { return m_bpp; }
+
+  /// powers the panel down, or back up, with FBIOBLANK. The front buffer keeps its contents so
+  /// unblanking shows the same picture again. Other backends only remember the state.
+  bool SetBlanked(bool blanked);
+  bool IsBlanked() const { return m_blanked; }
 
+  /// where the present workers run, and libvlc's video output thread from the next frame it shows.
+  void SetWorkerPlacement(const ThreadPlacement& placement);
+  void SetVideoPlacement(const ThreadPlacement& placement) { m_videoPlacement = placement; }
+  /// locks the back buffer, and the video buffers as they are made, into RAM.
+  void LockBuffers();
+
+  /// copies a screen saved by SaveSplash straight to the front buffer, returns false if there isn't
+  /// one or it was saved from a different resolution or pixel format.
+  bool ShowSplash(const char *path);
+  /// keeps what is on screen, in the front buffer's own format, for ShowSplash to put up at the next
+  /// start. The screen is copied straight away and written out on a background thread.
+  void SaveSplash(const char *path);
+
+  /// starts libvlc up on a background thread so the first video doesn't wait for it. The instance
+  /// is kept until the display is destroyed.
+  void StartVideoInit();
   bool VideoPlay(const char *filename);
+  /// loops 'filenames' on one player which is kept from clip to clip, so the video doesn't stop
+  /// until VideoStop. Each clip still opens its own input and decoders as it starts, so there is
+  /// a short pause between clips, a single clip repeats inside one input.
+  bool VideoPlayList(const std::vector<std::string>& filenames);
   void VideoStop();
+  bool IsVideoPlaying() const;
+  /// true while a VideoPlayList playlist is going round, which never stops by itself.
+  bool IsVideoLooping() const;
 
-  void SetVideoFrameObserver(std::function<void()> observer) {
-    m_videoFrameObserver = observer;
-  }
+  /// counts the video frames displayed, it is bumped from libvlc's thread so poll this rather than being called back.
+  unsigned GetVideoFrameCount() const { return m_videoFrameCount.load(std::memory_order_relaxed); }
 
-  void SetVideoStopObserver(std::function<void()> observer) {
+  /// called from libvlc's thread when a video stops, with how it played.
+  void SetVideoStopObserver(std::function<void(const VideoStats&)> observer) {
     m_videoStopObserver = observer;
   }  
+  VideoStats GetVideoStats() const;
   
   void SetVideoWindowX(int x) { m_videoWindowX = x; }
   void SetVideoWindowY(int y) { m_videoWindowY = y; }
   void SetVideoWindowWidth(int w) { m_videoWindowWidth = w; }    
+  /// asks libvlc for planar I420 frames, which are converted and doubled straight into the front
+  /// buffer, rather than RV16 from libvlc's own converter. Takes effect at the next VideoPlay.
+  void SetVideoYUV(bool yuv) { m_videoYUV = yuv; }
     
 
 protected:
+  unsigned vlcSetup(char *chroma, unsigned *width, unsigned *height, unsigned *pitches, unsigned *lines);
   void vlcLock(void **pPixels);
   void vlcUnlock(const uint16_t *pixels);
   void vlcDisplay();
@@ -60,6 +197,32 @@ protected:
   
 private:
   void StrokeCharacterLine(float x1, float y1, float x2, float y2, int xoff, int yoff);
+  bool OpenDevice();
+  bool OpenMemory();
+  bool OpenFile();
+  /// clips a rectangle to the screen, 'skipX' and 'skipY' say how much was cut from the top left.
+  bool ClipToScreen(int& xpos, int& ypos, int& width, int& height, int& skipX, int& skipY) const;
+  /// fills x0 to x1 inclusive on row y, clipping to the screen.
+  void FillSpan(int y, int x0, int x1, int color);
+  /// plots the four points mirrored around x, y, only checking bounds if 'clip' is set.
+  void PlotQuadrants(int x, int y, int dx, int dy, int color, bool clip);
+  void PlotPixel(int x, int y, int color);
+  /// these split big rectangles into bands for m_workers, the Band versions do one band.
+  void FillRows(const FBRect& rect, int color);
+  void FillBand(const FBRect& rect, int color);
+  void PresentRect(const FBRect& rect);
+  void PresentBand(const FBRect& rect);
+  /// presents 'rect' apart from any part of it covered by the video layer.
+  void PresentPageLayer(const FBRect& rect);
+  /// where the video frames are written, straight to the front buffer.
+  FBRect GetVideoRect() const;
+  bool VideoInit();
+  /// hands a new player's frames to us, 'notifyStop' has the stop observer called when it stops.
+  void AttachVideoPlayer(bool notifyStop);
+  void WaitVideoInit();
+  void VideoShutdown();
+
+  FBDisplayConfig m_config;
   
   int m_screenWidth = 0;
   int m_screenHeight = 0;
@@ -71,22 +234,58 @@ private:
   int m_stride = 0;
   std::vector<char> m_tmpFbp;
   char *m_realFbp = nullptr;
+  /// bytes per row of the front buffer, the back buffer is always tightly packed 32bit.
+  int m_frontStride = 0;
+  /// the front buffer for the memory backend.
+  std::vector<char> m_memFbp;
+  bool m_blanked = false;
+  bool m_lockBuffers = false;
+  ThreadPlacement m_videoPlacement;
+  /// whether libvlc's thread has been moved since the player started, only touched from that thread once it has.
+  bool m_videoPlaced = false;
+  /// what may hold something other than the clear colour, and what has changed since the last Present.
+  FBRegion m_content;
+  FBRegion m_damage;
   
   uint16_t *m_vlcFrame = nullptr;
   uint16_t *m_vlcPixels = nullptr;  
+  /// the Y, U and V planes of the I420 frame libvlc decodes into.
+  uint8_t *m_vlcPlanes = nullptr;
+  bool m_videoYUV = false;
+  /// whether the playing video is I420, only changed while libvlc isn't calling back.
+  bool m_playingYUV = false;
   int m_videoWidth = 320;
   int m_videoHeight = 240;
 
-  std::function<void()> m_videoFrameObserver;
-  std::function<void()> m_videoStopObserver;  
+  std::atomic<unsigned> m_videoFrameCount{0};
+  std::function<void(const VideoStats&)> m_videoStopObserver;  
+  /// per video counts for VideoStats, bumped from libvlc's thread.
+  std::atomic<unsigned> m_videoDecoded{0};
+  std::atomic<unsigned> m_videoDisplayed{0};
+  std::atomic<unsigned> m_videoDropped{0};
+  std::atomic<uint64_t> m_videoBlitMicros{0};
+  /// the frame pacing, only touched by libvlc's display callback once playing starts.
+  VideoPacer m_videoPacer;
+  /// set when a playlist moves on, the next frame period is taken from the new clip.
+  std::atomic<bool> m_videoRetime{false};
 
   int m_videoWindowWidth = 320;
   int m_videoWindowX = 0;
   int m_videoWindowY = 0;  
+  /// the part of the front buffer the playing video owns, empty when there isn't one.
+  FBRect m_videoLayer;
   
   static constexpr useconds_t MICROS = 1000000;
 
   struct VLCCallbacks {
+    static unsigned setup(void **opaque, char *chroma, unsigned *width, unsigned *height, unsigned *pitches, unsigned *lines) {
+      FBDisplay *thiz = (FBDisplay *)*opaque;
+      return thiz->vlcSetup(chroma, width, height, pitches, lines);
+    }
+
+    static void cleanup(void */*opaque*/) {
+    }
+    
     static void *lock(void *data, void **p_pixels) {
       FBDisplay *thiz = (FBDisplay *)data;
       thiz->vlcLock(p_pixels);
@@ -108,9 +307,19 @@ private:
       FBDisplay *thiz = (FBDisplay *)data;
       thiz->vlcStopEvent();
     }
+
+    static void mediaChanged(const struct libvlc_event_t */*event*/, void *data) {
+      FBDisplay *thiz = (FBDisplay *)data;
+      thiz->m_videoRetime.store(true, std::memory_order_relaxed);
+    }
   };
 
   struct VLCImpl *m_vlcImpl = nullptr;
+  class BandWorkers *m_workers = nullptr;
+  /// the front buffer's pixel layout, chosen by the backend.
+  const struct PixelKernels *m_pixelKernels = nullptr;
+  std::thread m_videoInitThread;
+  std::thread m_splashThread;
 };
 
 
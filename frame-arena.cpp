@@ -0,0 +1,97 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <stdlib.h>
+#include <string.h>
+
+#include <cstddef>
+#include <atomic>
+#include <new>
+#include <memory>
+#include <vector>
+#include <string_view>
+
+#include "frame-arena.h"
+
+void *FrameArena::Alloc(size_t size, size_t align)
+{
+  const size_t start = (m_used + align - 1) & ~(align - 1);
+  if(start + size <= m_block.size()) {
+    m_used = start + size;
+    return &m_block[start];
+  }
+
+  // new[] is aligned for any fundamental type which covers everything asked of the arena.
+  m_overflow.emplace_back(new char[size]);
+  m_overflowSize += size + align;
+  return m_overflow.back().get();
+}
+
+const char *FrameArena::CStr(std::string_view str)
+{
+  char *buf = AllocChars(str.size() + 1);
+  memcpy(buf, str.data(), str.size());
+  buf[str.size()] = 0;
+  return buf;
+}
+
+void FrameArena::Reset()
+{
+  if(!m_overflow.empty()) {
+    m_block.resize(m_block.size() + m_overflowSize);
+    m_overflow.clear();
+    m_overflowSize = 0;
+  }
+  m_used = 0;
+}
+
+#ifdef QUANTERM_ALLOC_DEBUG
+
+static std::atomic<size_t> g_heapAllocCount(0);
+
+size_t GetHeapAllocCount()
+{
+  return g_heapAllocCount.load(std::memory_order_relaxed);
+}
+
+void *operator new(size_t size)
+{
+  g_heapAllocCount.fetch_add(1, std::memory_order_relaxed);
+  void *p = malloc(size ? size : 1);
+  if(!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void *operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+  free(p);
+}
+
+#endif
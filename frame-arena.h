@@ -0,0 +1,42 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+/// A bump allocator for scratch memory which only lives for one frame of the main loop.
+/// Allocating is a pointer increment and Reset throws everything away at once. If a frame needs
+/// more than the block holds the extra comes from the heap and the block grows at the next Reset,
+/// so once the app settles down a frame doesn't touch the heap at all.
+class FrameArena {
+public:
+  explicit FrameArena(size_t initialSize = 64 * 1024) : m_block(initialSize) { }
+
+  void *Alloc(size_t size, size_t align = alignof(std::max_align_t));
+  char *AllocChars(size_t count) { return (char *)Alloc(count, 1); }
+  /// a nul terminated copy of 'str', for handing to C APIs like cairo.
+  const char *CStr(std::string_view str);
+
+  /// frees everything allocated since the last Reset.
+  void Reset();
+
+  /// true if the arena had to go to the heap since the last Reset.
+  bool HasOverflowed() const { return !m_overflow.empty(); }
+  
+private:
+  std::vector<char> m_block;
+  size_t m_used = 0;
+  std::vector<std::unique_ptr<char[]>> m_overflow;
+  size_t m_overflowSize = 0;
+};
+
+#ifdef QUANTERM_ALLOC_DEBUG
+/// The number of operator new calls made so far, counted by the replacement operator new built
+/// with QUANTERM_ALLOC_DEBUG. The main loop uses it to check frames don't allocate.
+size_t GetHeapAllocCount();
+#endif
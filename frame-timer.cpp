@@ -0,0 +1,220 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <stdio.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#include "frame-timer.h"
+
+#ifdef QUANTERM_TIMING
+
+// each thread keeps its last RingSize samples, the oldest are overwritten.
+static constexpr size_t RingSize = 16384;
+
+// only the owning thread writes a sample, the fields are atomic so a dump can read them while it does.
+struct PhaseSample {
+  std::atomic<uint64_t> m_startNS;
+  std::atomic<uint64_t> m_durationNS;
+  std::atomic<uint64_t> m_selfNS;
+  std::atomic<int> m_phase;
+};
+
+struct ThreadRing {
+  PhaseSample m_samples[RingSize];
+  /// samples written so far, stored after each sample is complete.
+  std::atomic<size_t> m_count{0};
+  pid_t m_tid;
+};
+
+// rings are never freed, the samples of a thread which has exited still go in the dump.
+static std::mutex g_ringsLock;
+static std::vector<ThreadRing *> g_rings;
+static thread_local ThreadRing *t_ring = nullptr;
+static thread_local ScopedPhaseTimer *t_openTimer = nullptr;
+
+static const char *g_phaseNames[TIMER_PHASE_COUNT] = {
+  "frame", "input", "parse", "layout", "draw", "image", "present", "sleep"
+};
+
+static volatile sig_atomic_t g_dumpRequested = 0;
+static std::string g_traceFile = "quanterm-trace.json";
+static uint64_t g_timerStartNS = TimerNowNS();
+
+uint64_t TimerNowNS()
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+void RecordPhaseTime(TimerPhase phase, uint64_t startNS, uint64_t endNS, uint64_t selfNS)
+{
+  if(!t_ring) {
+    t_ring = new ThreadRing;
+    t_ring->m_tid = pid_t(syscall(SYS_gettid));
+    std::lock_guard<std::mutex> lock(g_ringsLock);
+    g_rings.push_back(t_ring);
+  }
+
+  const size_t count = t_ring->m_count.load(std::memory_order_relaxed);
+  PhaseSample& sample = t_ring->m_samples[count % RingSize];
+  // pairs with the fence in CopyPhaseSamples, a dump which sees any of this sample also sees 'count'.
+  std::atomic_thread_fence(std::memory_order_release);
+  sample.m_startNS.store(startNS, std::memory_order_relaxed);
+  sample.m_durationNS.store(endNS - startNS, std::memory_order_relaxed);
+  sample.m_selfNS.store(selfNS, std::memory_order_relaxed);
+  sample.m_phase.store(phase, std::memory_order_relaxed);
+  t_ring->m_count.store(count + 1, std::memory_order_release);
+}
+
+ScopedPhaseTimer::ScopedPhaseTimer(TimerPhase phase) : m_phase(phase), m_startNS(TimerNowNS()), m_parent(t_openTimer)
+{
+  t_openTimer = this;
+}
+
+ScopedPhaseTimer::~ScopedPhaseTimer()
+{
+  const uint64_t endNS = TimerNowNS();
+  const uint64_t durationNS = endNS - m_startNS;
+  t_openTimer = m_parent;
+  if(m_parent)
+    m_parent->m_childNS += durationNS;
+  RecordPhaseTime(m_phase, m_startNS, endNS, durationNS - std::min(durationNS, m_childNS));
+}
+
+static void HandleDumpSignal(int)
+{
+  g_dumpRequested = 1;
+}
+
+void InitPhaseTimers(const char *traceFile)
+{
+  g_traceFile = traceFile;
+  signal(SIGUSR1, HandleDumpSignal);
+  printf("Phase timers on, SIGUSR1 dumps them to '%s'\n", traceFile);
+}
+
+void PollPhaseTimers()
+{
+  if(g_dumpRequested) {
+    g_dumpRequested = 0;
+    DumpPhaseTimers();
+  }
+}
+
+static void PrintHistogram(TimerPhase phase, std::vector<uint64_t>& durations)
+{
+  std::sort(durations.begin(), durations.end());
+  const size_t n = durations.size();
+  printf("%s: %zu samples, min %.1fus median %.1fus p99 %.1fus max %.1fus\n", g_phaseNames[phase], n,
+	 durations[0] / 1000.0, durations[n / 2] / 1000.0, durations[std::min(n - 1, n * 99 / 100)] / 1000.0,
+	 durations[n - 1] / 1000.0);
+
+  // power of two buckets in microseconds, the first catching everything under 1us.
+  constexpr int BucketCount = 24;
+  size_t buckets[BucketCount] = {0};
+  for(uint64_t d : durations) {
+    int b = 0;
+    for(uint64_t us = d / 1000; us && b < BucketCount - 1; us >>= 1)
+      ++b;
+    ++buckets[b];
+  }
+
+  for(int b = 0; b<BucketCount; b++) {
+    if(!buckets[b])
+      continue;
+    char range[32];
+    if(b == 0)
+      sprintf(range, "<1us");
+    else
+      sprintf(range, "%llu-%lluus", 1ull << (b - 1), 1ull << b);
+    const int bar = int((buckets[b] * 50 + n - 1) / n);
+    printf("  %16s %8zu %.*s\n", range, buckets[b], bar, "##################################################");
+  }
+}
+
+struct DumpedSample {
+  uint64_t m_startNS;
+  uint64_t m_durationNS;
+  uint64_t m_selfNS;
+  int m_phase;
+  pid_t m_tid;
+};
+
+// copies out what is in each thread's ring, leaving out any slot which may have been rewritten during the copy.
+static void CopyPhaseSamples(std::vector<DumpedSample>& samples)
+{
+  std::lock_guard<std::mutex> lock(g_ringsLock);
+  for(const ThreadRing *ring : g_rings) {
+    const size_t end = ring->m_count.load(std::memory_order_acquire);
+    const size_t begin = end - std::min(end, RingSize);
+    const size_t first = samples.size();
+    for(size_t n = begin; n<end; n++) {
+      const PhaseSample& sample = ring->m_samples[n % RingSize];
+      samples.push_back({sample.m_startNS.load(std::memory_order_relaxed), sample.m_durationNS.load(std::memory_order_relaxed),
+			 sample.m_selfNS.load(std::memory_order_relaxed), sample.m_phase.load(std::memory_order_relaxed), ring->m_tid});
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // sample n shares its slot with sample n + RingSize, which the thread may have started writing since.
+    const size_t after = ring->m_count.load(std::memory_order_relaxed);
+    const size_t safe = after + 1 - std::min(after + 1, RingSize);
+    if(safe > begin)
+      samples.erase(samples.begin() + first, samples.begin() + first + (std::min(safe, end) - begin));
+  }
+}
+
+void DumpPhaseTimers()
+{
+  std::vector<DumpedSample> samples;
+  CopyPhaseSamples(samples);
+
+  // the histograms are of each phase's own time, what nested phases took is counted under them.
+  std::vector<uint64_t> durations;
+  for(int p = 0; p<TIMER_PHASE_COUNT; p++) {
+    durations.clear();
+    for(const DumpedSample& sample : samples) {
+      if(sample.m_phase == p)
+	durations.push_back(sample.m_selfNS);
+    }
+    if(!durations.empty())
+      PrintHistogram(TimerPhase(p), durations);
+  }
+
+  FILE *file = fopen(g_traceFile.c_str(), "w");
+  if(!file) {
+    printf("Failed to write the trace '%s'\n", g_traceFile.c_str());
+    return;
+  }
+
+  // complete events, timestamps in microseconds since the timers started. The viewer nests the
+  // events of a thread by their times, so the full duration goes in rather than the own time.
+  fprintf(file, "{\"traceEvents\":[\n");
+  bool first = true;
+  for(const DumpedSample& sample : samples) {
+    fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", first ? "" : ",\n",
+	    g_phaseNames[sample.m_phase], int(getpid()), int(sample.m_tid), (sample.m_startNS - g_timerStartNS) / 1000.0,
+	    sample.m_durationNS / 1000.0);
+    first = false;
+  }
+  fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  fclose(file);
+  printf("Trace written to '%s'\n", g_traceFile.c_str());
+}
+
+#endif
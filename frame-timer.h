@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+/// The parts of a main loop iteration which can be timed. The timers are only built in with
+/// QUANTERM_TIMING (make TIMING=1), otherwise QT_SCOPED_TIMER compiles to nothing.
+enum TimerPhase {
+  TIMER_FRAME,
+  TIMER_INPUT,
+  TIMER_PARSE,
+  TIMER_LAYOUT,
+  TIMER_DRAW,
+  TIMER_IMAGE,
+  TIMER_PRESENT,
+  TIMER_SLEEP,
+  TIMER_PHASE_COUNT
+};
+
+#ifdef QUANTERM_TIMING
+
+/// nanoseconds from the monotonic clock.
+uint64_t TimerNowNS();
+/// adds a sample to the calling thread's ring buffer, 'selfNS' is the time not spent in nested phases.
+void RecordPhaseTime(TimerPhase phase, uint64_t startNS, uint64_t endNS, uint64_t selfNS);
+
+/// Times from its construction to the end of the scope, declare with QT_SCOPED_TIMER. Timers on
+/// the same thread nest, so PRESENT inside DRAW only counts once in the histograms.
+class ScopedPhaseTimer {
+public:
+  explicit ScopedPhaseTimer(TimerPhase phase);
+  ~ScopedPhaseTimer();
+
+private:
+  TimerPhase m_phase;
+  uint64_t m_startNS;
+  /// time spent in the timers nested inside this one.
+  uint64_t m_childNS = 0;
+  ScopedPhaseTimer *m_parent;
+};
+
+#define QT_TIMER_CONCAT2(a, b) a##b
+#define QT_TIMER_CONCAT(a, b) QT_TIMER_CONCAT2(a, b)
+#define QT_SCOPED_TIMER(phase) ScopedPhaseTimer QT_TIMER_CONCAT(scopedTimer, __LINE__)(phase)
+
+/// Hooks up SIGUSR1 to dump the timers, the trace goes to 'traceFile'.
+void InitPhaseTimers(const char *traceFile);
+/// Dumps the timers if SIGUSR1 has arrived since the last call.
+void PollPhaseTimers();
+/// Prints a histogram of each phase's own time and writes everything in the ring buffers out as
+/// a Chrome trace-event JSON file, where nested phases show up inside their parents.
+void DumpPhaseTimers();
+
+#else
+
+#define QT_SCOPED_TIMER(phase) ((void)0)
+
+#endif
@@ -8,10 +8,24 @@ The above copyright notice and this permission notice shall be included in all c
 THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */																																																	  
 #include <unistd.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <termios.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+
+#include <cstdint>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "kbhit.h"
+#include "frame-timer.h"
+#include "async-log.h"
 
 #if !defined(__x86_64__)
 
@@ -33,49 +47,65 @@ int g_initButtonStates[8] = {0};
 bool g_idling = false;
 double g_timeMS = 0.0;
 
+static bool g_GPIOInit = false;
+// the LEDs belong to the self-test until it is done.
+static std::atomic<bool> g_selfTestRunning{false};
 
-// returns an character code corresponding to a GPIO connected button or 0.
-char ReadGPIOEmulatedChar()
+void StartGPIO()
 {
-  static bool GPIOInit = false;
-  if(!GPIOInit) {
-    wiringPiSetupGpio();
-    for(int n = 0; n<8; n++) {
-      pinMode(ButtonPins[n], INPUT);
-      pullUpDnControl(ButtonPins[n], PUD_UP);      
-      pinMode(LedPins[n], OUTPUT);
-      // note these are inverted
-      digitalWrite(LedPins[n], HIGH);      
-    }
+  if(g_GPIOInit)
+    return;
+  
+  wiringPiSetupGpio();
+  for(int n = 0; n<8; n++) {
+    pinMode(ButtonPins[n], INPUT);
+    pullUpDnControl(ButtonPins[n], PUD_UP);      
+    pinMode(LedPins[n], OUTPUT);
+    // note these are inverted
+    digitalWrite(LedPins[n], HIGH);      
+  }
 
-    for(int n = 0; n<8; n++) {
-      int v = digitalRead(ButtonPins[n]);
-      g_initButtonStates[n] = v;
-      printf("GPIO button %i(%i) state %i\n", n, ButtonPins[n], v);
+  for(int n = 0; n<8; n++) {
+    int v = digitalRead(ButtonPins[n]);
+    g_initButtonStates[n] = v;
+    printf("GPIO button %i(%i) state %i\n", n, ButtonPins[n], v);
+  }
+  g_GPIOInit = true;
 
+  // blinking takes a few seconds, so it happens alongside the rest of startup.
+  g_selfTestRunning = true;
+  std::thread([]() {
+    for(int n = 0; n<8; n++) {
       for(int t = 0; t<2; t++) {
-	printf("Blinking %i %i\n", n, LedPins[n]);
+	LogMessage(LOG_LEVEL_DEBUG, "Blinking %i %i\n", n, LedPins[n]);
 	constexpr int nswait = 1000 * 100;
 	digitalWrite(LedPins[n], LOW);
 	usleep(nswait);
 	digitalWrite(LedPins[n], HIGH);
 	usleep(nswait);
       }
-    }    
-    
-    GPIOInit = true;    
-  }
+    }
+    g_selfTestRunning = false;
+  }).detach();
+}
+
+char ReadGPIOEmulatedChar()
+{
+  if(!g_GPIOInit)
+    StartGPIO();
 
   int lightToBlink = -1;
   if(g_idling)
     lightToBlink = int(g_timeMS / 200.0) % 4;
+  const bool driveLeds = !g_selfTestRunning;
   
   for(int n = 0; n<8; n++) {
     if(g_initButtonStates[n] == 1) {
       int v = digitalRead(ButtonPins[n]);
-      digitalWrite(LedPins[n], v && (lightToBlink != (n&3)) ? HIGH : LOW);
+      if(driveLeds)
+	digitalWrite(LedPins[n], v && (lightToBlink != (n&3)) ? HIGH : LOW);
       if(!v) {
-	printf("GPIO button %i down\n", n);
+	LogRateLimited(LOG_LEVEL_INFO, 1000, "GPIO button %i down\n", n);
 	return '1' + n;
       }
     }
@@ -92,6 +122,11 @@ void SetGPIOAttractorState(bool idling, double timeMS)
 
 #else
 
+void StartGPIO()
+{
+
+}
+
 char ReadGPIOEmulatedChar()
 {
   return 0;
@@ -106,6 +141,132 @@ void SetGPIOAttractorState(bool, double)
 
 static bool g_headless = false;
 
+// input traces are text, a line per character "<ms> <char code>" and a final "<ms> end" so a replay lasts as long as
+// the recorded session did. A code of 0 is input that was ignored as a repeat.
+struct InputEvent {
+  double m_timeMS;
+  char m_ch;
+};
+
+static FILE *g_recordFile = nullptr;
+static bool g_replaying = false;
+static std::vector<InputEvent> g_replayEvents;
+static size_t g_replayPos = 0;
+static double g_replayEndMS = 0.0;
+static double g_replaySpeed = 1.0;
+static std::chrono::steady_clock::time_point g_traceStart;
+static bool g_traceStarted = false;
+
+static double TraceTimeMS()
+{
+  // the clock starts with the first poll of the input so the time spent starting up isn't part of the trace.
+  if(!g_traceStarted) {
+    g_traceStart = std::chrono::steady_clock::now();
+    g_traceStarted = true;
+  }
+  const std::chrono::duration<double, std::milli> delta = std::chrono::steady_clock::now() - g_traceStart;
+  return delta.count();
+}
+
+bool StartInputRecording(const char *path)
+{
+  StopInputTrace();
+  g_recordFile = fopen(path, "w");
+  if(!g_recordFile) {
+    printf("Failed to create input trace '%s'\n", path);
+    return false;
+  }
+  fprintf(g_recordFile, "# quanterm input trace\n");
+  printf("Recording input to '%s'\n", path);
+  return true;
+}
+
+bool StartInputReplay(const char *path, double speed)
+{
+  StopInputTrace();
+  FILE *file = fopen(path, "r");
+  if(!file) {
+    printf("Failed to read input trace '%s'\n", path);
+    return false;
+  }
+
+  g_replayEvents.clear();
+  g_replayEndMS = 0.0;
+  char line[128];
+  while(fgets(line, sizeof(line), file)) {
+    if(line[0] == '#')
+      continue;
+    double timeMS = 0.0;
+    char value[16];
+    if(sscanf(line, "%lf %15s", &timeMS, value) != 2)
+      continue;
+    if(strcmp(value, "end") != 0)
+      g_replayEvents.push_back({timeMS, char(atoi(value))});
+    g_replayEndMS = std::max(g_replayEndMS, timeMS);
+  }
+  fclose(file);
+
+  g_replayPos = 0;
+  g_replaySpeed = speed > 0.0 ? speed : 1.0;
+  g_replaying = true;
+  printf("Replaying %zu input events from '%s' at %.2fx\n", g_replayEvents.size(), path, g_replaySpeed);
+  return true;
+}
+
+double TraceClockMS()
+{
+  // until the first poll starts the trace a replay's clock waits at zero with it.
+  if(g_replaying)
+    return g_traceStarted ? TraceTimeMS() * g_replaySpeed : 0.0;
+  const std::chrono::duration<double, std::milli> now = std::chrono::steady_clock::now().time_since_epoch();
+  return now.count();
+}
+
+bool IsInputReplayFinished()
+{
+  return g_replaying && g_replayPos == g_replayEvents.size() && TraceTimeMS() * g_replaySpeed >= g_replayEndMS;
+}
+
+void StopInputTrace()
+{
+  if(g_recordFile) {
+    fprintf(g_recordFile, "%.3f end\n", TraceTimeMS());
+    fclose(g_recordFile);
+    g_recordFile = nullptr;
+  }
+  g_replaying = false;
+  g_replayEvents.clear();
+  g_traceStarted = false;
+}
+
+static bool ReplayEventDue()
+{
+  return g_replayPos < g_replayEvents.size() && TraceTimeMS() * g_replaySpeed >= g_replayEvents[g_replayPos].m_timeMS;
+}
+
+static char AcceptChar(char ch)
+{
+  // a held button reads as the same character every poll, it only counts again once it has been held a while.
+  constexpr std::chrono::milliseconds KeyRepeatTime(2000);
+  static char lastChar = 0;
+  static std::chrono::steady_clock::time_point lastTime = std::chrono::steady_clock::now();
+  const auto now = std::chrono::steady_clock::now();
+  const bool repeat = ch == lastChar && now - lastTime <= KeyRepeatTime;
+  if(!repeat) {
+    lastChar = ch;
+    lastTime = now;
+  }
+
+  // the trace holds what the app acts on, so a replay at any speed does the same. A swallowed repeat is kept as 0
+  // as it still counts as someone being there.
+  const char accepted = repeat ? 0 : ch;
+  if(g_recordFile) {
+    fprintf(g_recordFile, "%.3f %i\n", TraceTimeMS(), int(accepted));
+    fflush(g_recordFile);
+  }
+  return accepted;
+}
+
 void SetKbHeadless(bool b)
 {
   g_headless = b;
@@ -150,6 +311,12 @@ void DisableRawMode()
 
 bool Kbhit()
 {
+  QT_SCOPED_TIMER(TIMER_INPUT);
+  if(g_replaying)
+    return ReplayEventDue();
+  if(g_recordFile)
+    TraceTimeMS();
+  
   char ch = ReadGPIOEmulatedChar();
   if(ch != 0)
     return true;
@@ -164,22 +331,53 @@ bool Kbhit()
   }
   
   if(byteswaiting != 0)
-    printf("Bytes waiting %i\n", byteswaiting);
+    LogRateLimited(LOG_LEVEL_DEBUG, 1000, "Bytes waiting %i\n", byteswaiting);
   return byteswaiting > 0;
 }
 
+bool WaitForInput(int timeoutMS)
+{
+  constexpr int GPIOPollMS = 20;
+  const auto start = std::chrono::steady_clock::now();
+  for(;;) {
+    if(Kbhit())
+      return true;
+    if(IsInputReplayFinished())
+      return false;
+
+    int wait = GPIOPollMS;
+    if(timeoutMS >= 0) {
+      const int elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+      if(elapsed >= timeoutMS)
+	return false;
+      wait = std::min(wait, timeoutMS - elapsed);
+    }
+    
+    if(g_headless || g_replaying) {
+      usleep(wait * 1000);
+    } else {
+      pollfd pfd = {0, POLLIN, 0};
+      poll(&pfd, 1, wait);
+    }
+  }
+}
+
 char ReadChar()
 {
+  QT_SCOPED_TIMER(TIMER_INPUT);
+  if(g_replaying)
+    return ReplayEventDue() ? g_replayEvents[g_replayPos++].m_ch : 0;
+  
   char ch = ReadGPIOEmulatedChar();
   if(ch != 0)
-    return ch;
+    return AcceptChar(ch);
 
   if(g_headless)
     return 0;  
   
   int s = read(0,&ch,1);
   if(s > 0)
-    return ch;
+    return AcceptChar(ch);
   else
     return 0;
 }
@@ -15,9 +15,34 @@ void SetKbHeadless(bool b);
 void EnableRawMode();
 void DisableRawMode();
 bool Kbhit();
+/// Returns the next character, or 0 for none. The same character again within 2 seconds is a held
+/// button and also comes back as 0.
 char ReadChar();
+/// Sleeps until Kbhit would return true or 'timeoutMS' has gone by, a negative timeout waits for
+/// ever. The keyboard wakes it straight away, the GPIO buttons are looked at every few milliseconds.
+/// Returns whether there is input, a finished replay returns false rather than waiting.
+bool WaitForInput(int timeoutMS);
 
-/// On the RPi this will initalise the GPIOs and trigger a self-test of the LEDs.
+/// On the RPi this initialises the GPIOs and blinks each LED as a self-test on a background thread,
+/// the buttons can be read straight away.
+void StartGPIO();
+/// returns an character code corresponding to a GPIO connected button or 0, on the RPi the first call
+/// will call StartGPIO if it hasn't been.
 char ReadGPIOEmulatedChar();
 
 void SetGPIOAttractorState(bool idling, double timeMS);
+
+/// Writes every character ReadChar returns to 'path' along with when it happened, timed from the first Kbhit call.
+/// Held button repeats are written as 0, so replaying at any speed acts on exactly the same presses.
+bool StartInputRecording(const char *path);
+/// Feeds a trace written by StartInputRecording through Kbhit and ReadChar in place of the real input.
+/// 'speed' above 1 replays it faster.
+bool StartInputReplay(const char *path, double speed);
+/// The clock in milliseconds the app's idle timers run on. While replaying it is the trace's own
+/// time, running at the replay speed, so the idle timeout, attractor and blanking come between the
+/// same presses as they did when the trace was recorded. Otherwise it is the monotonic clock.
+double TraceClockMS();
+/// true once a replay has reached the end of its trace.
+bool IsInputReplayFinished();
+/// Finishes off a recording or replay.
+void StopInputTrace();
@@ -0,0 +1,124 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <cairo.h>
+
+#include "page-data.h"
+#include "page-bundle.h"
+
+// quanterm-pack - compiles a pages root into a single bundle which quanterm can mmap with -bundle.
+
+static bool EndsWith(const std::string& str, const char *suffix)
+{
+  const size_t len = strlen(suffix);
+  return str.size() >= len && str.compare(str.size() - len, len, suffix) == 0;
+}
+
+/// Decodes a png and adds its pixels in cairo's native ARGB32 layout.
+static bool PackImage(PageBundleWriter& writer, const std::string& path, const std::string& name)
+{
+  cairo_surface_t *png = cairo_image_surface_create_from_png(path.c_str());
+  if(cairo_surface_status(png) != CAIRO_STATUS_SUCCESS) {
+    printf("Failed to decode image: '%s'\n", path.c_str());
+    cairo_surface_destroy(png);
+    return false;
+  }
+
+  const int width = cairo_image_surface_get_width(png);
+  const int height = cairo_image_surface_get_height(png);
+  cairo_surface_t *argb = png;
+  
+  // opaque pngs come back as RGB24 whose padding byte is undefined, so flatten those into ARGB32.
+  if(cairo_image_surface_get_format(png) != CAIRO_FORMAT_ARGB32) {
+    argb = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    cairo_t *cr = cairo_create(argb);
+    cairo_set_source_surface(cr, png, 0, 0);
+    cairo_paint(cr);
+    cairo_destroy(cr);
+  }
+
+  cairo_surface_flush(argb);
+  writer.AddImage(name, cairo_image_surface_get_data(argb), width, height, cairo_image_surface_get_stride(argb));
+  printf("Image '%s' %i x %i\n", name.c_str(), width, height);
+  
+  if(argb != png)
+    cairo_surface_destroy(argb);
+  cairo_surface_destroy(png);
+  return true;
+}
+
+static bool PackPage(PageBundleWriter& writer, const std::string& path, const std::string& name)
+{
+  std::string content;
+  std::vector<ButtonData> buttons;
+  if(!ReadPageFile(path, content, buttons))
+    return false;
+  writer.AddPage(name, content, buttons);
+  printf("Page '%s' %zu bytes, %zu buttons\n", name.c_str(), content.size(), buttons.size());
+  return true;
+}
+
+/// Walks the pages root adding pages and images by their path relative to the root.
+static bool PackDirectory(PageBundleWriter& writer, const std::string& root, const std::string& relDir)
+{
+  const std::string dirPath = relDir.empty() ? root : root + "/" + relDir;
+  DIR *dir = opendir(dirPath.c_str());
+  if(!dir) {
+    printf("Failed to open directory: '%s'\n", dirPath.c_str());
+    return false;
+  }
+
+  bool ok = true;
+  while(dirent *ent = readdir(dir)) {
+    const std::string fname = ent->d_name;
+    if(fname[0] == '.')
+      continue;
+    
+    const std::string name = relDir.empty() ? fname : relDir + "/" + fname;
+    const std::string path = root + "/" + name;
+    
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0)
+      continue;
+
+    if(S_ISDIR(st.st_mode))
+      ok = PackDirectory(writer, root, name) && ok;
+    else if(EndsWith(fname, ".png"))
+      ok = PackImage(writer, path, name) && ok;
+    else if(EndsWith(fname, ".txt") && fname.compare(0, 12, "page-config-") != 0)
+      ok = PackPage(writer, path, name) && ok;
+  }
+  
+  closedir(dir);
+  return ok;
+}
+
+int main(int ac, char **av)
+{
+  if(ac != 3) {
+    printf("Usage: %s <pages root> <output bundle>\n", av[0]);
+    return 1;
+  }
+
+  PageBundleWriter writer;
+  if(!PackDirectory(writer, av[1], ""))
+    return 1;
+  
+  return writer.Write(av[2]) ? 0 : 1;
+}
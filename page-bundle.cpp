@@ -0,0 +1,339 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "page-data.h"
+#include "page-bundle.h"
+
+using namespace PageBundleFormat;
+
+static uint32_t AlignUp(uint32_t v, uint32_t align)
+{
+  return (v + align - 1) & ~(align - 1);
+}
+
+bool PageBundle::Open(const char *filename)
+{
+  Close();
+  
+  int fd = open(filename, O_RDONLY);
+  if(fd == -1) {
+    printf("Failed to open bundle: '%s'\n", filename);
+    return false;
+  }
+
+  struct stat st;
+  if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header)) {
+    printf("Bundle too small: '%s'\n", filename);
+    close(fd);
+    return false;
+  }
+
+  void *data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps the file alive, the descriptor isn't needed any more.
+  close(fd);
+  if(data == MAP_FAILED) {
+    printf("Failed to mmap bundle: '%s'\n", filename);
+    return false;
+  }
+
+  m_data = (const unsigned char *)data;
+  m_size = st.st_size;
+  m_header = (const Header *)m_data;
+
+  if(memcmp(m_header->m_magic, MAGIC, sizeof(MAGIC)) != 0 ||
+     m_header->m_version != VERSION ||
+     m_header->m_byteOrder != BYTE_ORDER_TAG) {
+    printf("Bundle has the wrong magic, version or byte order: '%s'\n", filename);
+    Close();
+    return false;
+  }
+
+  auto InRange = [&](uint32_t offset, uint64_t len) {
+    return (uint64_t)offset + len <= m_size;
+  };
+  
+  if(!InRange(m_header->m_pageIndexOffset, (uint64_t)m_header->m_pageCount * sizeof(Page)) ||
+     !InRange(m_header->m_buttonTableOffset, (uint64_t)m_header->m_buttonCount * sizeof(Button)) ||
+     !InRange(m_header->m_tokenTableOffset, (uint64_t)m_header->m_tokenCount * sizeof(PageToken)) ||
+     !InRange(m_header->m_imageIndexOffset, (uint64_t)m_header->m_imageCount * sizeof(Image)) ||
+     !InRange(m_header->m_stringTableOffset, m_header->m_stringTableSize)) {
+    printf("Bundle is truncated: '%s'\n", filename);
+    Close();
+    return false;
+  }
+
+  // the tables are read in place, unaligned reads would fault on older ARMs.
+  if(m_header->m_pageIndexOffset % alignof(Page) || m_header->m_buttonTableOffset % alignof(Button) ||
+     m_header->m_tokenTableOffset % alignof(PageToken) || m_header->m_imageIndexOffset % alignof(Image)) {
+    printf("Bundle tables are misaligned: '%s'\n", filename);
+    Close();
+    return false;
+  }
+
+  m_pages = (const Page *)(m_data + m_header->m_pageIndexOffset);
+  m_buttons = (const Button *)(m_data + m_header->m_buttonTableOffset);
+  m_tokens = (const PageToken *)(m_data + m_header->m_tokenTableOffset);
+  m_images = (const Image *)(m_data + m_header->m_imageIndexOffset);
+  m_strings = (const char *)(m_data + m_header->m_stringTableOffset);
+
+  if(!Validate()) {
+    printf("Bundle is corrupt: '%s'\n", filename);
+    Close();
+    return false;
+  }
+
+  printf("Opened bundle '%s': %u pages, %u images\n", filename, m_header->m_pageCount, m_header->m_imageCount);
+  return true;
+}
+
+bool PageBundle::Validate() const
+{
+  const uint32_t stringsSize = m_header->m_stringTableSize;
+  // with the table ending in a nul every string inside it is terminated.
+  if(stringsSize && m_strings[stringsSize - 1] != 0) {
+    printf("Bundle string table isn't terminated\n");
+    return false;
+  }
+  auto StringOk = [&](uint32_t offset) { return offset < stringsSize; };
+
+  for(uint32_t n = 0; n<m_header->m_buttonCount; n++) {
+    if(!StringOk(m_buttons[n].m_caption) || !StringOk(m_buttons[n].m_cmd)) {
+      printf("Bundle button %u has a bad string\n", n);
+      return false;
+    }
+  }
+
+  for(uint32_t n = 0; n<m_header->m_pageCount; n++) {
+    const Page& page = m_pages[n];
+    // the content is a string too, so its nul has to be inside the table as well.
+    if(!StringOk(page.m_name) || (uint64_t)page.m_content + page.m_contentLen >= stringsSize) {
+      printf("Bundle page %u has a bad name or content\n", n);
+      return false;
+    }
+    if((uint64_t)page.m_firstButton + page.m_buttonCount > m_header->m_buttonCount ||
+       (uint64_t)page.m_firstToken + page.m_tokenCount > m_header->m_tokenCount) {
+      printf("Bundle page '%s' has buttons or tokens outside the tables\n", GetString(page.m_name));
+      return false;
+    }
+    const PageToken *tokens = m_tokens + page.m_firstToken;
+    for(uint32_t t = 0; t<page.m_tokenCount; t++) {
+      if(tokens[t].m_type > PageToken::PREFORMAT_END || (uint64_t)tokens[t].m_pos + tokens[t].m_len > page.m_contentLen) {
+	printf("Bundle page '%s' token %u is outside its content\n", GetString(page.m_name), t);
+	return false;
+      }
+    }
+  }
+
+  for(uint32_t n = 0; n<m_header->m_imageCount; n++) {
+    const Image& image = m_images[n];
+    if(!StringOk(image.m_name)) {
+      printf("Bundle image %u has a bad name\n", n);
+      return false;
+    }
+    // cairo takes the sizes as ints and reads stride * height bytes from the data.
+    if(image.m_width > 0x7fff || image.m_height > 0x7fff || image.m_stride % 4 ||
+       (uint64_t)image.m_stride < (uint64_t)image.m_width * 4 ||
+       (uint64_t)image.m_dataOffset + (uint64_t)image.m_stride * image.m_height > m_size) {
+      printf("Bundle image '%s' has bad dimensions or data\n", GetString(image.m_name));
+      return false;
+    }
+  }
+  return true;
+}
+
+void PageBundle::Close()
+{
+  if(m_data)
+    munmap((void *)m_data, m_size);
+  m_data = nullptr;
+  m_size = 0;
+  m_header = nullptr;
+  m_pages = nullptr;
+  m_buttons = nullptr;
+  m_tokens = nullptr;
+  m_images = nullptr;
+  m_strings = nullptr;
+}
+
+const Page *PageBundle::FindPage(const char *name) const
+{
+  if(!m_data)
+    return nullptr;
+  
+  const Page *end = m_pages + m_header->m_pageCount;
+  const Page *it = std::lower_bound(m_pages, end, name, [this](const Page& page, const char *n) {
+    return strcmp(GetString(page.m_name), n) < 0;
+  });
+  if(it == end || strcmp(GetString(it->m_name), name) != 0)
+    return nullptr;
+  return it;
+}
+
+const Button *PageBundle::GetButtons(const Page *page) const
+{
+  return m_buttons + page->m_firstButton;
+}
+
+const char *PageBundle::GetPageContent(const Page *page) const
+{
+  return GetString(page->m_content);
+}
+
+const PageToken *PageBundle::GetTokens(const Page *page) const
+{
+  return m_tokens + page->m_firstToken;
+}
+
+const Image *PageBundle::FindImage(const char *name) const
+{
+  if(!m_data)
+    return nullptr;
+  
+  const Image *end = m_images + m_header->m_imageCount;
+  const Image *it = std::lower_bound(m_images, end, name, [this](const Image& image, const char *n) {
+    return strcmp(GetString(image.m_name), n) < 0;
+  });
+  if(it == end || strcmp(GetString(it->m_name), name) != 0)
+    return nullptr;
+  return it;
+}
+
+const unsigned char *PageBundle::GetImagePixels(const Image *image) const
+{
+  return m_data + image->m_dataOffset;
+}
+
+uint32_t PageBundleWriter::AddString(const std::string& str)
+{
+  auto it = m_stringOffsets.find(str);
+  if(it != m_stringOffsets.end())
+    return it->second;
+  
+  uint32_t offset = m_strings.size();
+  m_strings += str;
+  m_strings.push_back('\0');
+  m_stringOffsets[str] = offset;
+  return offset;
+}
+
+void PageBundleWriter::AddPage(const std::string& name, const std::string& content, const std::vector<ButtonData>& buttons)
+{
+  PendingPage pending;
+  pending.m_name = name;
+  pending.m_page.m_name = AddString(name);
+  pending.m_page.m_content = AddString(content);
+  pending.m_page.m_contentLen = content.size();
+  pending.m_page.m_firstButton = m_buttons.size();
+  pending.m_page.m_buttonCount = buttons.size();
+  for(const auto& btn : buttons)
+    m_buttons.push_back({AddString(btn.m_caption), AddString(btn.m_cmd)});
+
+  std::vector<PageToken> tokens;
+  TokenisePage(content.c_str(), content.size(), tokens);
+  pending.m_page.m_firstToken = m_tokens.size();
+  pending.m_page.m_tokenCount = tokens.size();
+  m_tokens.insert(m_tokens.end(), tokens.begin(), tokens.end());
+  m_pages.push_back(pending);
+}
+
+void PageBundleWriter::AddImage(const std::string& name, const unsigned char *pixels, int width, int height, int stride)
+{
+  PendingImage pending;
+  pending.m_name = name;
+  pending.m_image.m_name = AddString(name);
+  pending.m_image.m_width = width;
+  pending.m_image.m_height = height;
+  pending.m_image.m_stride = stride;
+  pending.m_image.m_dataOffset = 0;
+  pending.m_pixels.assign(pixels, pixels + (stride * height));
+  m_images.push_back(std::move(pending));
+}
+
+bool PageBundleWriter::Write(const char *filename)
+{
+  std::sort(m_pages.begin(), m_pages.end(), [](const PendingPage& a, const PendingPage& b) {
+    return a.m_name < b.m_name;
+  });
+  std::sort(m_images.begin(), m_images.end(), [](const PendingImage& a, const PendingImage& b) {
+    return a.m_name < b.m_name;
+  });
+
+  Header header;
+  memcpy(header.m_magic, MAGIC, sizeof(MAGIC));
+  header.m_version = VERSION;
+  header.m_byteOrder = BYTE_ORDER_TAG;
+  header.m_pageCount = m_pages.size();
+  header.m_buttonCount = m_buttons.size();
+  header.m_tokenCount = m_tokens.size();
+  header.m_imageCount = m_images.size();
+  header.m_stringTableSize = m_strings.size();
+
+  uint32_t offset = sizeof(Header);
+  header.m_pageIndexOffset = offset;
+  offset += m_pages.size() * sizeof(Page);
+  header.m_buttonTableOffset = offset;
+  offset += m_buttons.size() * sizeof(Button);
+  header.m_tokenTableOffset = offset;
+  offset += m_tokens.size() * sizeof(PageToken);
+  header.m_imageIndexOffset = offset;
+  offset += m_images.size() * sizeof(Image);
+  header.m_stringTableOffset = offset;
+  offset += m_strings.size();
+
+  for(auto& img : m_images) {
+    offset = AlignUp(offset, DATA_ALIGN);
+    img.m_image.m_dataOffset = offset;
+    offset += img.m_pixels.size();
+  }
+
+  FILE *file = fopen(filename, "wb");
+  if(!file) {
+    printf("Failed to create bundle: '%s'\n", filename);
+    return false;
+  }
+
+  bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+  for(const auto& page : m_pages)
+    ok = ok && fwrite(&page.m_page, sizeof(Page), 1, file) == 1;
+  if(m_buttons.size())
+    ok = ok && fwrite(&m_buttons[0], sizeof(Button), m_buttons.size(), file) == m_buttons.size();
+  if(m_tokens.size())
+    ok = ok && fwrite(&m_tokens[0], sizeof(PageToken), m_tokens.size(), file) == m_tokens.size();
+  for(const auto& img : m_images)
+    ok = ok && fwrite(&img.m_image, sizeof(Image), 1, file) == 1;
+  ok = ok && fwrite(m_strings.data(), 1, m_strings.size(), file) == m_strings.size();
+  
+  for(const auto& img : m_images) {
+    static const char zeros[DATA_ALIGN] = {0};
+    const long pad = img.m_image.m_dataOffset - ftell(file);
+    ok = ok && fwrite(zeros, 1, pad, file) == (size_t)pad;
+    ok = ok && fwrite(&img.m_pixels[0], 1, img.m_pixels.size(), file) == img.m_pixels.size();
+  }
+  
+  if(fclose(file) != 0 || !ok) {
+    printf("Failed to write bundle: '%s'\n", filename);
+    return false;
+  }
+
+  printf("Wrote bundle '%s': %zu pages, %zu images, %u bytes\n", filename, m_pages.size(), m_images.size(), offset);
+  return true;
+}
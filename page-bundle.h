@@ -0,0 +1,130 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+/// The on-disk layout of a compiled page bundle, as written by quanterm-pack.
+/// Everything is stored in the native byte order of the machine that packed it and all offsets
+/// are from the start of the file so the bundle can be used directly from a read-only mmap.
+/// Names, captions and commands are offsets into the string table, each string is nul terminated.
+namespace PageBundleFormat {
+  constexpr char MAGIC[8] = {'Q', 'T', 'B', 'U', 'N', 'D', 'L', 'E'};
+  constexpr uint32_t VERSION = 2;
+  constexpr uint32_t BYTE_ORDER_TAG = 0x01020304;
+  /// image data is aligned to this so cairo can use it in place.
+  constexpr uint32_t DATA_ALIGN = 16;
+
+  struct Header {
+    char m_magic[8];
+    uint32_t m_version;
+    uint32_t m_byteOrder;
+    uint32_t m_pageCount;
+    uint32_t m_pageIndexOffset;
+    uint32_t m_buttonCount;
+    uint32_t m_buttonTableOffset;
+    uint32_t m_tokenCount;
+    uint32_t m_tokenTableOffset;
+    uint32_t m_imageCount;
+    uint32_t m_imageIndexOffset;
+    uint32_t m_stringTableOffset;
+    uint32_t m_stringTableSize;
+  };
+
+  /// the page index is sorted by name. The content is kept alongside its tokens as they refer into it.
+  struct Page {
+    uint32_t m_name;
+    uint32_t m_content;
+    uint32_t m_contentLen;
+    uint32_t m_firstButton;
+    uint32_t m_buttonCount;
+    uint32_t m_firstToken;
+    uint32_t m_tokenCount;
+  };
+
+  struct Button {
+    uint32_t m_caption;
+    uint32_t m_cmd;
+  };
+
+  /// the image index is sorted by name, pixels are cairo ARGB32 (premultiplied, native endian).
+  struct Image {
+    uint32_t m_name;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_stride;
+    uint32_t m_dataOffset;
+  };
+}
+
+/// A read-only view of a bundle file. Pages and image pixels are used in place from the mapping.
+class PageBundle {
+public:
+  PageBundle() { }
+  ~PageBundle() { Close(); }
+
+  bool Open(const char *filename);
+  void Close();
+  bool IsOpen() const { return m_data != nullptr; }
+
+  /// returns nullptr if the bundle doesn't contain the page.
+  const PageBundleFormat::Page *FindPage(const char *name) const;
+  const PageBundleFormat::Button *GetButtons(const PageBundleFormat::Page *page) const;
+  const char *GetPageContent(const PageBundleFormat::Page *page) const;
+  const PageToken *GetTokens(const PageBundleFormat::Page *page) const;
+
+  /// returns nullptr if the bundle doesn't contain the image.
+  const PageBundleFormat::Image *FindImage(const char *name) const;
+  const unsigned char *GetImagePixels(const PageBundleFormat::Image *image) const;
+
+  const char *GetString(uint32_t offset) const { return m_strings + offset; }
+
+private:
+  /// checks every entry points inside the mapping, so nothing read later can go outside it.
+  bool Validate() const;
+
+  const unsigned char *m_data = nullptr;
+  size_t m_size = 0;
+  const PageBundleFormat::Header *m_header = nullptr;
+  const PageBundleFormat::Page *m_pages = nullptr;
+  const PageBundleFormat::Button *m_buttons = nullptr;
+  const PageToken *m_tokens = nullptr;
+  const PageBundleFormat::Image *m_images = nullptr;
+  const char *m_strings = nullptr;
+};
+
+/// Builds up a bundle in memory and writes it out, used by quanterm-pack.
+class PageBundleWriter {
+public:
+  void AddPage(const std::string& name, const std::string& content, const std::vector<ButtonData>& buttons);
+  /// 'pixels' is cairo ARGB32 data with the given stride.
+  void AddImage(const std::string& name, const unsigned char *pixels, int width, int height, int stride);
+
+  bool Write(const char *filename);
+
+private:
+  uint32_t AddString(const std::string& str);
+
+  struct PendingPage {
+    std::string m_name;
+    PageBundleFormat::Page m_page;
+  };
+
+  struct PendingImage {
+    std::string m_name;
+    PageBundleFormat::Image m_image;
+    std::vector<unsigned char> m_pixels;
+  };
+
+  std::vector<PendingPage> m_pages;
+  std::vector<PendingImage> m_images;
+  std::vector<PageBundleFormat::Button> m_buttons;
+  std::vector<PageToken> m_tokens;
+  std::string m_strings;
+  std::map<std::string, uint32_t> m_stringOffsets;
+};
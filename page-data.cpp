@@ -0,0 +1,184 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "page-data.h"
+
+bool ParsePageData(std::istream& file, std::string& content, std::vector<ButtonData>& buttons)
+{
+  const std::string newline("\n");
+  content = "";
+  buttons.clear();
+  
+  for(std::string line; std::getline(file, line); ) {
+    if(!line.length()) {
+      content += newline;
+      continue;
+    }
+
+    // comment
+    if(line[0] == '#')
+      continue;
+
+    // button
+    if(line[0] == '$') {
+      ButtonData btnData;
+      const char *ptr = line.c_str();
+      // skip the '$'
+      ++ptr;
+      while(*ptr && *ptr != '!') {
+	if(*ptr == '\\') {
+	  ++ptr;
+	  if(*ptr && *ptr == 'n') {
+	    ++ptr;
+	    btnData.m_caption.push_back('\n');
+	  }
+	} else {	    
+	  btnData.m_caption.push_back(*ptr++);
+	}
+      }
+      
+      // did we reach the end or a '!' ??
+      if(*ptr) {
+	// skip the '!'
+	++ptr;
+	while(*ptr)
+	  btnData.m_cmd.push_back(*ptr++);
+      }
+      buttons.push_back(btnData);
+      continue;
+    }
+    
+    content += line;
+    content += newline;
+  }
+
+  return true;
+}
+
+bool ReadPageFile(const std::string& path, std::string& content, std::vector<ButtonData>& buttons)
+{
+  std::ifstream file(path);
+  if(!file) {
+    printf("Failed to read: '%s'\n", path.c_str());
+    return false;
+  }
+
+  return ParsePageData(file, content, buttons);
+}
+
+void TokenisePage(const char *content, uint32_t len, std::vector<PageToken>& tokens)
+{
+  tokens.clear();
+  
+  auto Add = [&](PageToken::Type type, uint32_t pos, uint32_t tokLen) {
+    PageToken tok = {pos, tokLen, type, {0, 0, 0}};
+    tokens.push_back(tok);
+  };
+  
+  uint32_t n = 0;
+  while(n < len) {
+    switch(content[n]) {
+    case '\\': // escape
+      if(n + 1 < len) {
+	if(content[n+1] == 'n') {
+	  Add(PageToken::NEWLINE, n + 1, 0);
+	} else if(content[n+1] == '+') {
+	  Add(PageToken::PREFORMAT_START, n + 1, 0);
+	  // everything up to the end of the line is taken literally.
+	  const uint32_t start = n + 2;
+	  uint32_t end = start;
+	  while(end < len && content[end] != '\n')
+	    ++end;
+	  if(end > start)
+	    Add(PageToken::TEXT, start, end - start);
+	  if(end < len)
+	    Add(PageToken::PREFORMAT_END, end, 0);
+	  n = end + 1;
+	  continue;
+	}
+      }
+      n += 2;
+      continue;
+    case '_':
+      Add(PageToken::BOLD, n, 0);
+      break;
+    case '[':
+      Add(PageToken::IMAGE_START, n, 0);
+      break;
+    case ']':
+      Add(PageToken::IMAGE_END, n, 0);
+      break;
+    case '=':
+      Add(PageToken::HEADING, n, 0);
+      break;
+    case '\n':
+      if(n > 0 && content[n-1] == '\n')
+	Add(PageToken::BREAK, n, 0);
+      else
+	Add(PageToken::SPACE, n, 0);
+      break;
+    default: {
+      // gather up a run of plain characters into one span
+      uint32_t end = n + 1;
+      while(end < len && !strchr("\\_[]=\n", content[end]))
+	++end;
+      Add(PageToken::TEXT, n, end - n);
+      n = end;
+      continue;
+    }
+    }
+    ++n;
+  }
+}
+
+void PageDocument::SetContent(std::string&& content)
+{
+  m_ownedContent = std::move(content);
+  TokenisePage(m_ownedContent.c_str(), m_ownedContent.size(), m_ownedTokens);
+  m_content = m_ownedContent.c_str();
+  m_len = m_ownedContent.size();
+  m_tokens = m_ownedTokens.data();
+  m_tokenCount = m_ownedTokens.size();
+}
+
+PageDocument& PageDocument::operator=(const PageDocument& other)
+{
+  if(this == &other)
+    return *this;
+  
+  if(other.m_content == other.m_ownedContent.c_str()) {
+    m_ownedContent = other.m_ownedContent;
+    m_ownedTokens = other.m_ownedTokens;
+    m_content = m_ownedContent.c_str();
+    m_len = m_ownedContent.size();
+    m_tokens = m_ownedTokens.data();
+    m_tokenCount = m_ownedTokens.size();
+  } else {
+    SetExternal(other.m_content, other.m_len, other.m_tokens, other.m_tokenCount);
+  }
+  return *this;
+}
+
+void PageDocument::SetExternal(const char *content, uint32_t len, const PageToken *tokens, uint32_t tokenCount)
+{
+  m_ownedContent.clear();
+  m_ownedTokens.clear();
+  m_content = content;
+  m_len = len;
+  m_tokens = tokens;
+  m_tokenCount = tokenCount;
+}
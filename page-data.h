@@ -0,0 +1,79 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+/// holds the data for each button - the kiosk has 8, 4 down each size.
+struct ButtonData {
+  std::string m_caption;
+  std::string m_cmd;
+};
+
+/// One lexed piece of page content. Text is kept as a span of the content rather than copied.
+/// m_pos is the content offset of the character that triggers the token, so a page partially revealed
+/// up to 'howMuch' characters runs every token with m_pos < howMuch, and text spans are cut short.
+/// This is a plain struct because bundles store arrays of them as-is.
+struct PageToken {
+  enum Type : uint8_t {
+    TEXT,		///< append m_len characters from m_pos to the current text
+    SPACE,		///< a single newline in the source, which joins lines with a space
+    NEWLINE,		///< the \n escape, a hard newline within the text
+    BREAK,		///< an empty line, the current text is rendered
+    BOLD,		///< '_' toggles bold
+    HEADING,		///< '=' toggles heading
+    IMAGE_START,	///< '[' the following text is an image name
+    IMAGE_END,		///< ']' the image is rendered
+    PREFORMAT_START,	///< the \+ escape, the rest of the line is literal
+    PREFORMAT_END	///< the newline ending a preformatted line, which is rendered unwrapped
+  };
+
+  uint32_t m_pos;
+  uint32_t m_len;
+  uint8_t m_type;
+  uint8_t m_pad[3];
+};
+
+/// Lexes page content into tokens, see RenderPageContent for how they are used.
+void TokenisePage(const char *content, uint32_t len, std::vector<PageToken>& tokens);
+
+/// The content of a page and its token stream. Either owns both or refers to them in a bundle.
+class PageDocument {
+public:
+  PageDocument() { }
+  PageDocument(const PageDocument& other) { *this = other; }
+  /// copies are careful to point at their own storage rather than the original's.
+  PageDocument& operator=(const PageDocument& other);
+  
+  /// takes the content and tokenises it.
+  void SetContent(std::string&& content);
+  /// refers to already tokenised content, the storage must outlive the document.
+  void SetExternal(const char *content, uint32_t len, const PageToken *tokens, uint32_t tokenCount);
+  void Clear() { SetExternal("", 0, nullptr, 0); }
+
+  const char *GetContent() const { return m_content; }
+  uint32_t GetLength() const { return m_len; }
+  const PageToken *GetTokens() const { return m_tokens; }
+  uint32_t GetTokenCount() const { return m_tokenCount; }
+
+private:
+  std::string m_ownedContent;
+  std::vector<PageToken> m_ownedTokens;
+  
+  const char *m_content = "";
+  uint32_t m_len = 0;
+  const PageToken *m_tokens = nullptr;
+  uint32_t m_tokenCount = 0;
+};
+
+/// Parses a specially crafted page file, splitting it into the page content and the button definitions.
+/// Comments are dropped and the remaining lines are joined with newlines, ready for TokenisePage.
+bool ParsePageData(std::istream& file, std::string& content, std::vector<ButtonData>& buttons);
+
+/// As ParsePageData but opens the file at 'path' first.
+bool ReadPageFile(const std::string& path, std::string& content, std::vector<ButtonData>& buttons);
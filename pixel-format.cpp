@@ -0,0 +1,192 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <string.h>
+
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define QT_YUV_NEON
+#endif
+
+#include "pixel-format.h"
+
+// libvlc's RV16 frames have blue in the top bits, as far as the screen is concerned.
+typedef PixelBGR565 VideoPixel;
+
+template<typename Format> static void FromARGBRow(void *dst, const uint32_t *src, int width)
+{
+  if constexpr(Format::CopiesARGB) {
+    memcpy(dst, src, width * 4);
+  } else {
+    typename Format::Pixel *out = (typename Format::Pixel *)dst;
+    for(int x = 0; x<width; x++)
+      out[x] = Format::FromARGB(src[x]);
+  }
+}
+
+template<typename Format> static typename Format::Pixel FromVideo(uint16_t pix)
+{
+  if constexpr(std::is_same<Format, VideoPixel>::value)
+    return pix;
+  else
+    return Format::FromARGB(VideoPixel::ToARGB(pix));
+}
+
+template<typename Format> static void FromVideoRow(void *dst, const uint16_t *src, int width)
+{
+  typename Format::Pixel *out = (typename Format::Pixel *)dst;
+  for(int x = 0; x<width; x++)
+    out[x] = FromVideo<Format>(src[x]);
+}
+
+template<typename Format> static void FromVideoRowDouble(void *dst, const uint16_t *src, int width)
+{
+  typename Format::Pixel *out = (typename Format::Pixel *)dst;
+  for(int x = 0; x<width; x++) {
+    const typename Format::Pixel pix = FromVideo<Format>(src[x]);
+    out[x * 2] = pix;
+    out[x * 2 + 1] = pix;
+  }
+}
+
+// BT.601 video range YUV to RGB in 10.6 fixed point, small enough that the NEON version works in
+// 16bit lanes. Where a sum can overflow it only does so past 255, where both versions saturate.
+constexpr int YScale = 75;
+constexpr int VToR = 102;
+constexpr int UToG = -25;
+constexpr int VToG = -52;
+constexpr int UToB = 129;
+
+static inline uint32_t YUVToARGB(int y, int u, int v)
+{
+  const int c = YScale * (y - 16);
+  const int d = u - 128;
+  const int e = v - 128;
+  auto Clamp = [](int x) { return uint32_t(std::min(255, std::max(0, (x + 32) >> 6))); };
+  return 0xff000000 | (Clamp(c + VToR * e) << 16) | (Clamp(c + UToG * d + VToG * e) << 8) | Clamp(c + UToB * d);
+}
+
+#if defined(QT_YUV_NEON)
+
+/// 16 pixels of r, g and b from 16 luma samples and the 8 chroma pairs they share.
+static inline void YUVToRGB16(const uint8_t *y, const uint8_t *u, const uint8_t *v, uint8x16_t& r, uint8x16_t& g, uint8x16_t& b)
+{
+  const int16x8_t d = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(u), vdup_n_u8(128)));
+  const int16x8_t e = vreinterpretq_s16_u16(vsubl_u8(vld1_u8(v), vdup_n_u8(128)));
+  
+  // each chroma term covers two luma samples.
+  const int16x8x2_t rc = vzipq_s16(vmulq_n_s16(e, VToR), vmulq_n_s16(e, VToR));
+  const int16x8_t gTerm = vmlaq_n_s16(vmulq_n_s16(d, UToG), e, VToG);
+  const int16x8x2_t gc = vzipq_s16(gTerm, gTerm);
+  const int16x8x2_t bc = vzipq_s16(vmulq_n_s16(d, UToB), vmulq_n_s16(d, UToB));
+
+  const uint8x16_t luma = vld1q_u8(y);
+  const int16x8_t c0 = vmulq_n_s16(vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(luma), vdup_n_u8(16))), YScale);
+  const int16x8_t c1 = vmulq_n_s16(vreinterpretq_s16_u16(vsubl_u8(vget_high_u8(luma), vdup_n_u8(16))), YScale);
+  
+  r = vcombine_u8(vqrshrun_n_s16(vqaddq_s16(c0, rc.val[0]), 6), vqrshrun_n_s16(vqaddq_s16(c1, rc.val[1]), 6));
+  g = vcombine_u8(vqrshrun_n_s16(vqaddq_s16(c0, gc.val[0]), 6), vqrshrun_n_s16(vqaddq_s16(c1, gc.val[1]), 6));
+  b = vcombine_u8(vqrshrun_n_s16(vqaddq_s16(c0, bc.val[0]), 6), vqrshrun_n_s16(vqaddq_s16(c1, bc.val[1]), 6));
+}
+
+/// packs 8 pixels to 565 with 'hi' in the top bits.
+static inline uint16x8_t Pack565x8(uint8x8_t hi, uint8x8_t mid, uint8x8_t lo)
+{
+  return vsriq_n_u16(vsriq_n_u16(vshll_n_u8(hi, 8), vshll_n_u8(mid, 8), 5), vshll_n_u8(lo, 8), 11);
+}
+
+/// writes 16 pixels doubled across to 32 in the format.
+template<typename Format> static inline void StoreDoubled(void *dst, uint8x16_t r, uint8x16_t g, uint8x16_t b)
+{
+  if constexpr(Format::Bytes == 2) {
+    const uint8x16_t hi = Format::RedShift ? r : b;
+    const uint8x16_t lo = Format::RedShift ? b : r;
+    uint16_t *out = (uint16_t *)dst;
+    const uint16x8_t p0 = Pack565x8(vget_low_u8(hi), vget_low_u8(g), vget_low_u8(lo));
+    const uint16x8_t p1 = Pack565x8(vget_high_u8(hi), vget_high_u8(g), vget_high_u8(lo));
+    const uint16x8x2_t d0 = vzipq_u16(p0, p0);
+    const uint16x8x2_t d1 = vzipq_u16(p1, p1);
+    vst1q_u16(out, d0.val[0]);
+    vst1q_u16(out + 8, d0.val[1]);
+    vst1q_u16(out + 16, d1.val[0]);
+    vst1q_u16(out + 24, d1.val[1]);
+  } else {
+    const uint8x16x2_t rr = vzipq_u8(r, r);
+    const uint8x16x2_t gg = vzipq_u8(g, g);
+    const uint8x16x2_t bb = vzipq_u8(b, b);
+    const uint8x16_t ff = vdupq_n_u8(255);
+    uint8_t *out = (uint8_t *)dst;
+    vst4q_u8(out, uint8x16x4_t{{bb.val[0], gg.val[0], rr.val[0], ff}});
+    vst4q_u8(out + 64, uint8x16x4_t{{bb.val[1], gg.val[1], rr.val[1], ff}});
+  }
+}
+
+#endif
+
+template<typename Format> static void FromYUVRowDouble(void *dst, int dstStride, const uint8_t *y, const uint8_t *u, const uint8_t *v, int width)
+{
+  typedef typename Format::Pixel Pixel;
+  Pixel *out0 = (Pixel *)dst;
+  Pixel *out1 = (Pixel *)((char *)dst + dstStride);
+  int x = 0;
+#if defined(QT_YUV_NEON)
+  for(; x + 16 <= width; x += 16) {
+    uint8x16_t r, g, b;
+    YUVToRGB16(y + x, u + (x / 2), v + (x / 2), r, g, b);
+    StoreDoubled<Format>(out0 + (x * 2), r, g, b);
+    StoreDoubled<Format>(out1 + (x * 2), r, g, b);
+  }
+#endif
+  for(; x<width; x++) {
+    const Pixel pix = Format::FromARGB(YUVToARGB(y[x], u[x / 2], v[x / 2]));
+    out0[x * 2] = out0[x * 2 + 1] = pix;
+    out1[x * 2] = out1[x * 2 + 1] = pix;
+  }
+}
+
+template<typename Format> static constexpr PixelKernels MakeKernels(PixelFormat format, const char *name)
+{
+  return PixelKernels{format, name, Format::Bytes * 8, Format::RedShift, Format::AlphaBits,
+		      FromARGBRow<Format>, FromVideoRow<Format>, FromVideoRowDouble<Format>, FromYUVRowDouble<Format>};
+}
+
+// in PixelFormat order.
+static const PixelKernels Kernels[PIXEL_FORMAT_COUNT] = {
+  MakeKernels<PixelARGB8888>(PIXEL_ARGB8888, "ARGB8888"),
+  MakeKernels<PixelXRGB8888>(PIXEL_XRGB8888, "XRGB8888"),
+  MakeKernels<PixelRGB565>(PIXEL_RGB565, "RGB565"),
+  MakeKernels<PixelBGR565>(PIXEL_BGR565, "BGR565")
+};
+
+const PixelKernels& GetPixelKernels(PixelFormat format)
+{
+  return Kernels[format];
+}
+
+const PixelKernels *FindPixelKernels(int bitsPerPixel, int redShift, bool hasAlpha)
+{
+  for(const PixelKernels& kernels : Kernels) {
+    if(kernels.m_bitsPerPixel == bitsPerPixel && kernels.m_redShift == redShift && (kernels.m_alphaBits > 0) == hasAlpha)
+      return &kernels;
+  }
+  return nullptr;
+}
+
+const char *YUVKernelName()
+{
+#if defined(QT_YUV_NEON)
+  return "NEON";
+#else
+  return "C++";
+#endif
+}
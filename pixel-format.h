@@ -0,0 +1,89 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+// Packed pixel layouts for the front buffer. The back buffer is always ARGB8888, the same as a cairo
+// image surface, so these only come into play where pixels cross over to the screen: presenting the
+// back buffer and converting video frames. Each layout is a set of compile time traits, and the row
+// kernels are instantiated once per layout so their inner loops don't branch on the format.
+
+enum PixelFormat {
+  PIXEL_ARGB8888,
+  PIXEL_XRGB8888,
+  PIXEL_RGB565,
+  PIXEL_BGR565,
+  PIXEL_FORMAT_COUNT
+};
+
+/// Channel sizes and positions for a pixel of type T, a zero sized alpha means the layout is opaque.
+template<typename T, int RBits, int RShift, int GBits, int GShift, int BBits, int BShift, int ABits, int AShift>
+struct PixelTraits {
+  typedef T Pixel;
+  static constexpr int Bytes = sizeof(T);
+  static constexpr int RedShift = RShift;
+  static constexpr int AlphaBits = ABits;
+  static constexpr T RedMask = T(((1u << RBits) - 1) << RShift);
+  static constexpr T GreenMask = T(((1u << GBits) - 1) << GShift);
+  static constexpr T BlueMask = T(((1u << BBits) - 1) << BShift);
+  static constexpr T AlphaMask = T(((1u << ABits) - 1) << AShift);
+  /// bits no channel uses, set when packing so an X byte reads back as opaque.
+  static constexpr T PadMask = T(~(RedMask | GreenMask | BlueMask | AlphaMask));
+  /// true when an ARGB8888 pixel can be copied as it is, whatever lands in the alpha byte.
+  static constexpr bool CopiesARGB = Bytes == 4 && RShift == 16 && GShift == 8 && BShift == 0 && RBits == 8 && GBits == 8 && BBits == 8;
+
+  /// packs an ARGB8888 colour, dropping the low bits of each channel.
+  static constexpr T FromARGB(uint32_t argb) {
+    return T(((((argb >> 16) & 0xff) >> (8 - RBits)) << RShift) |
+	     ((((argb >> 8) & 0xff) >> (8 - GBits)) << GShift) |
+	     (((argb & 0xff) >> (8 - BBits)) << BShift) |
+	     (ABits ? (((argb >> 24) >> (8 - ABits)) << AShift) : PadMask));
+  }
+
+  /// unpacks to ARGB8888, copying the top bits of each channel into the bottom so white stays white.
+  static constexpr uint32_t ToARGB(T pix) {
+    return (ABits ? Widen<ABits>((pix & AlphaMask) >> AShift) << 24 : 0xff000000) |
+      (Widen<RBits>((pix & RedMask) >> RShift) << 16) |
+      (Widen<GBits>((pix & GreenMask) >> GShift) << 8) |
+      Widen<BBits>((pix & BlueMask) >> BShift);
+  }
+
+  template<int Bits> static constexpr uint32_t Widen(uint32_t value) {
+    return Bits >= 8 ? value : ((value << (8 - Bits)) | (value >> (Bits * 2 > 8 ? Bits * 2 - 8 : 0)));
+  }
+};
+
+typedef PixelTraits<uint32_t, 8, 16, 8, 8, 8, 0, 8, 24> PixelARGB8888;
+typedef PixelTraits<uint32_t, 8, 16, 8, 8, 8, 0, 0, 24> PixelXRGB8888;
+typedef PixelTraits<uint16_t, 5, 11, 6, 5, 5, 0, 0, 0> PixelRGB565;
+typedef PixelTraits<uint16_t, 5, 0, 6, 5, 5, 11, 0, 0> PixelBGR565;
+
+/// The row kernels for one format, FBDisplay looks these up once in Open. Rows are 'width' pixels
+/// and 'dst' points into the front buffer.
+struct PixelKernels {
+  PixelFormat m_format;
+  const char *m_name;
+  int m_bitsPerPixel;
+  int m_redShift;
+  int m_alphaBits;
+  /// converts back buffer pixels.
+  void (*m_fromARGB)(void *dst, const uint32_t *src, int width);
+  /// converts libvlc's 16bit video pixels, the Double version writes each one twice across.
+  void (*m_fromVideo)(void *dst, const uint16_t *src, int width);
+  void (*m_fromVideoDouble)(void *dst, const uint16_t *src, int width);
+  /// converts a row of planar I420 video, 'width' luma samples and half as many of each chroma,
+  /// doubled both ways into two rows 'dstStride' bytes apart. This is NEON when the compiler targets it.
+  void (*m_fromYUVDouble)(void *dst, int dstStride, const uint8_t *y, const uint8_t *u, const uint8_t *v, int width);
+};
+
+const PixelKernels& GetPixelKernels(PixelFormat format);
+/// finds the layout with the given depth, red channel position and alpha, nullptr if there isn't one.
+const PixelKernels *FindPixelKernels(int bitsPerPixel, int redShift, bool hasAlpha);
+/// which flavour of the YUV kernels is built in.
+const char *YUVKernelName();
@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <string.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <algorithm>
+
+#include "pixel-runs.h"
+
+namespace {
+constexpr uint32_t RepeatFlag = 0x80000000u;
+constexpr size_t MaxRun = 0x7fffffffu;
+/// shorter repeats than this are cheaper left in with the literals.
+constexpr size_t MinRepeat = 3;
+
+bool IsRepeatAt(const uint32_t *src, size_t pos, size_t count)
+{
+  return pos + MinRepeat <= count && src[pos] == src[pos + 1] && src[pos] == src[pos + 2];
+}
+}
+
+void EncodePixelRuns(const uint32_t *src, size_t count, std::vector<uint32_t>& out)
+{
+  size_t pos = 0;
+  while(pos < count) {
+    if(IsRepeatAt(src, pos, count)) {
+      size_t run = MinRepeat;
+      while(pos + run < count && run < MaxRun && src[pos + run] == src[pos])
+	++run;
+      out.push_back(RepeatFlag | uint32_t(run));
+      out.push_back(src[pos]);
+      pos += run;
+      continue;
+    }
+
+    // literals carry on until the next repeat starts.
+    const size_t start = pos;
+    while(pos < count && pos - start < MaxRun && !IsRepeatAt(src, pos, count))
+      ++pos;
+    out.push_back(uint32_t(pos - start));
+    out.insert(out.end(), src + start, src + pos);
+  }
+}
+
+bool DecodePixelRuns(const uint32_t *runs, size_t runCount, uint32_t *dst, size_t count)
+{
+  const uint32_t *runsEnd = runs + runCount;
+  size_t pos = 0;
+  while(runs < runsEnd) {
+    const uint32_t control = *runs++;
+    const size_t run = control & ~RepeatFlag;
+    if(run > count - pos)
+      return false;
+    
+    if(control & RepeatFlag) {
+      if(runs == runsEnd)
+	return false;
+      std::fill_n(dst + pos, run, *runs++);
+    } else {
+      if(size_t(runsEnd - runs) < run)
+	return false;
+      memcpy(dst + pos, runs, run * sizeof(uint32_t));
+      runs += run;
+    }
+    pos += run;
+  }
+  return pos == count;
+}
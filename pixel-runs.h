@@ -0,0 +1,17 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+/// Run length encodes 'count' 32bit pixels onto the end of 'out'. Each run starts with a control
+/// word, with the top bit set it is a repeat of the one pixel which follows, otherwise that many
+/// pixels follow as they are. Pages are mostly flat background so they shrink a long way.
+void EncodePixelRuns(const uint32_t *src, size_t count, std::vector<uint32_t>& out);
+/// Expands what EncodePixelRuns wrote into 'dst', returns false if 'runs' doesn't hold exactly 'count' pixels.
+bool DecodePixelRuns(const uint32_t *runs, size_t runCount, uint32_t *dst, size_t count);
@@ -0,0 +1,1510 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/																																																	  
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <string.h>
+#include <strings.h>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string_view>
+#include <cassert>
+
+#include <cairo.h>
+
+#include "thread-tuning.h"
+#include "video-pacer.h"
+#include "fb-display.h"
+#include "kbhit.h"
+#include "page-data.h"
+#include "page-bundle.h"
+#include "frame-arena.h"
+#include "frame-timer.h"
+#include "async-log.h"
+#include "pixel-runs.h"
+#include "quanterm-app.h"
+
+FBDisplay& DisplayInst() {
+  static FBDisplay g_display;
+  return g_display;
+}
+
+CairoPtr& CairoInst() {
+  static CairoPtr g_cr = nullptr;
+  return g_cr;
+}
+
+double RandFloat(const double minV, const double maxV)
+{
+  return minV + (double(rand()) * (maxV - minV)) / double(RAND_MAX);
+}
+
+void cairo_rounded_rectangle(double x, double y, double width, double height)
+{
+  auto& cr = CairoInst();
+  double aspect = 1.0;
+  double corner_radius = height / 10.0;
+
+  double radius = corner_radius / aspect;
+  double degrees = M_PI / 180.0;
+
+  cairo_new_sub_path (cr);
+  cairo_arc (cr, x + width - radius, y + radius, radius, -90 * degrees, 0 * degrees);
+  cairo_arc (cr, x + width - radius, y + height - radius, radius, 0 * degrees, 90 * degrees);
+  cairo_arc (cr, x + radius, y + height - radius, radius, 90 * degrees, 180 * degrees);
+  cairo_arc (cr, x + radius, y + radius, radius, 180 * degrees, 270 * degrees);
+  cairo_close_path (cr);
+}
+
+/// Overrides the usual cairo C API to take our own colour vector.
+void cairo_set_source_rgb(CairoPtr pCairo, const QRGB& colour)
+{
+  cairo_set_source_rgb(pCairo, colour.r, colour.g, colour.b);
+}
+
+bool QuanTermPageConfig::LoadPageConfig(const char *filename)
+{
+  std::ifstream file(filename);
+  if(!file) {
+    printf("Failed to read: '%s'\n", filename);
+    return false;
+  }
+
+  for(std::string line; std::getline(file, line); ) {
+    if(!line.length())
+      continue;
+
+    auto pos = std::string::npos;
+    pos = line.find("=");
+    if(pos == std::string::npos) {
+      printf("Bad config line (no '='): '%s'\n", line.c_str());
+      return false;
+    }
+    std::string name = line.substr(0, pos);
+    if(!name.length()) {
+      printf("Bad config line (empty name): '%s'\n", line.c_str());
+      return false;      
+    }
+    
+    std::string value = line.substr(pos+1, -1);
+    if(!value.length()) {
+      printf("Bad config line (empty value): '%s'\n", line.c_str());
+      return false;      
+    }
+
+    printf("Read '%s' -> '%s'\n", name.c_str(), value.c_str());
+
+    // is the a vector (color) ?
+    if(value[0] == '[' && value[value.length()-1] == ']') {
+      float r, g, b;
+      int c = sscanf(value.c_str(), "[%f,%f,%f]", &r, &g, &b);
+      if(c != 3) {
+	printf("Malformed vec3 (colour): '%s'\n", value.c_str());
+	return false;
+      }
+      if(!QuanTermProp<QRGB>::UpdateProp(name, QRGB(r, g, b))) {
+	printf("Unknown config colour '%s'\n", name.c_str());
+	return false;
+      }
+      continue;
+      
+    }
+
+    // is this a string?
+    if(value.length() >= 2 && value[0] == '"' && value[value.length()-1] == '"') {
+      if(!QuanTermProp<std::string>::UpdateProp(name, value.substr(1, value.length()-2))) {
+	printf("Unknown config string '%s'\n", name.c_str());
+	return false;
+      }
+      continue;
+    }
+
+    // otherwise, its a number...
+    if(!QuanTermProp<double>::UpdateProp(name, atof(value.c_str()))) {
+      printf("Unknown config number '%s'\n", name.c_str());
+      return false;
+    }
+  }
+
+  return true;
+}
+
+double GetTimeMS()
+{
+  static const auto start = std::chrono::steady_clock::now();
+  const auto current = std::chrono::steady_clock::now();
+  const std::chrono::duration<double, std::milli> delta = current - start;
+  return delta.count();
+}
+
+int QuanTermApp::ShowWrappedText(std::string_view txt, size_t shownLen, const int x, int y, const int maxWidth)
+{
+  // save position before word
+  // add a word
+  // see how long
+  // too long?
+  //   print position before word
+  //   rewind to word and repeat
+  // no?
+  //  repeat.
+
+  cairo_select_font_face (CairoInst(), "monospace", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+  cairo_set_font_size(CairoInst(), m_pageCfg.FontSizeNormal);
+
+  // cheap and dirty way to get the line spacing.
+  cairo_text_extents_t heightExtents;
+  cairo_text_extents(CairoInst(), "My", &heightExtents);
+  heightExtents.height += 4.0;
+  
+  cairo_text_extents_t extents;
+
+  // the line is built in place, words are tried on the end of it and chopped off again if too long.
+  // it can never be longer than the text so one frame allocation covers it.
+  char *line = m_frameArena.AllocChars(txt.size() + 1);
+  size_t lineLen = 0;
+  line[0] = 0;
+
+  auto TextOut = [&](const char *text) {
+    QT_SCOPED_TIMER(TIMER_DRAW);
+    cairo_text_extents(CairoInst(), text, &extents);    
+    cairo_move_to(CairoInst(), x, y);
+    cairo_rectangle(CairoInst(), x, y - extents.height +2, extents.width, extents.height);    
+    cairo_set_source_rgb(CairoInst(), m_pageCfg.TextBackgroundColour);
+    cairo_fill(CairoInst());
+    
+    cairo_move_to(CairoInst(), x, y);
+    cairo_set_source_rgb(CairoInst(), m_pageCfg.TextColour);
+    cairo_show_text(CairoInst(), text);
+    
+    y += heightExtents.height;
+  };
+
+  size_t pos = 0;
+  while(pos < shownLen) {
+    // skip the whitespace
+    if(txt[pos] == ' ' || txt[pos] == '\n') {
+      ++pos;
+      continue;
+    }
+
+    // find the end of the word
+    const size_t wordStart = pos;
+    while(pos < txt.size() && txt[pos] != ' ' && txt[pos] != '\n')
+      ++pos;
+    const size_t wordLen = pos - wordStart;
+    
+    // it it longer than the space allowed?
+    const size_t prevLen = lineLen;
+    if(lineLen > 0)
+      line[lineLen++] = ' ';
+    memcpy(line + lineLen, txt.data() + wordStart, wordLen);
+    lineLen += wordLen;
+    line[lineLen] = 0;
+
+    {
+      QT_SCOPED_TIMER(TIMER_LAYOUT);
+      cairo_text_extents(CairoInst(), line, &extents);
+    }
+
+    if(extents.width > maxWidth) {
+      // it is too long, print from the previous word if there was one.
+      // TODO: need have there not being a previous word, which would mean there is no
+      // natural break in the line. The current behaviour is print nothing and hope the
+      // author fixes it.
+      line[prevLen] = 0;
+      TextOut(line);
+
+      memmove(line, txt.data() + wordStart, wordLen);
+      lineLen = wordLen;
+      line[lineLen] = 0;
+    }
+
+    // a word still being revealed has been placed by its full length, only what is revealed is drawn.
+    if(pos > shownLen) {
+      lineLen -= pos - shownLen;
+      line[lineLen] = 0;
+    }
+  }
+
+  TextOut(line);
+  return y;
+}
+
+/// Renders out multple text lines which are split by newline characters.
+void QuanTermApp::ShowTextMultiline(std::string_view txt, const int xorigin, const int yorigin)
+{
+  QT_SCOPED_TIMER(TIMER_DRAW);
+  int ypos = yorigin;
+
+  // cheap and dirty way to get the line spacing.
+  cairo_text_extents_t heightExtents;
+  cairo_text_extents(CairoInst(), "My", &heightExtents);
+  heightExtents.height += 4.0;  
+
+  ypos += heightExtents.height;
+
+  // take a copy with the newlines replaced by terminators so each line can go straight to cairo.
+  char *lines = (char *)m_frameArena.CStr(txt);
+  const char *line = lines;
+  for(size_t n = 0; n<=txt.size(); n++) {
+    if(n == txt.size() || lines[n] == '\n') {
+      lines[n] = 0;
+      if(*line) {
+	cairo_move_to(CairoInst(), xorigin, ypos);
+	cairo_show_text(CairoInst(), line);
+      }
+      if(n != txt.size())
+	ypos += heightExtents.height;
+      line = lines + n + 1;
+    }
+  }
+}
+
+/// Gets the size of a block of text.
+void QuanTermApp::SizeTextMultiline(std::string_view txt, int& width, int& height)
+{
+  QT_SCOPED_TIMER(TIMER_LAYOUT);
+  width = 0;
+  height = 0;
+  
+  cairo_text_extents_t heightExtents;
+  cairo_text_extents(CairoInst(), "My", &heightExtents);
+  heightExtents.height += 4.0;  
+
+  char *lines = (char *)m_frameArena.CStr(txt);
+  const char *line = lines;
+  for(size_t n = 0; n<=txt.size(); n++) {
+    if(n == txt.size() || lines[n] == '\n') {
+      lines[n] = 0;
+      if(*line) {
+	cairo_text_extents_t lineExtents;
+	cairo_text_extents(CairoInst(), line, &lineExtents);
+	width = std::max(width, int(lineExtents.width));
+      }
+      // every newline moves down a line, as does a last line without one.
+      if(n != txt.size() || *line)
+	height += int(heightExtents.height);
+      line = lines + n + 1;
+    }
+  }
+}
+
+/// Read a file containing a page of text, images, stuff and button definitions.
+bool QuanTermApp::ReadPageData(const std::string& filename, PageDocument& page, std::vector<ButtonData>& buttons)
+{
+  QT_SCOPED_TIMER(TIMER_PARSE);
+  const PageBundleFormat::Page *bundlePage = m_bundle.FindPage(filename.c_str());
+  if(bundlePage) {
+    // already tokenised, so the page is used straight from the bundle.
+    page.SetExternal(m_bundle.GetPageContent(bundlePage), bundlePage->m_contentLen,
+		     m_bundle.GetTokens(bundlePage), bundlePage->m_tokenCount);
+    const PageBundleFormat::Button *btns = m_bundle.GetButtons(bundlePage);
+    buttons.clear();
+    for(uint32_t n = 0; n<bundlePage->m_buttonCount; n++)
+      buttons.push_back({m_bundle.GetString(btns[n].m_caption), m_bundle.GetString(btns[n].m_cmd)});
+  } else {
+    std::string content;
+    if(!ReadPageFile(m_pagesRoot + "/" + filename, content, buttons))
+      return false;
+    page.SetContent(std::move(content));
+  }
+
+  LogMessage(LOG_LEVEL_DEBUG, "--\n%.*s\n--\n", (int)page.GetLength(), page.GetContent());
+  return true;
+}
+
+cairo_surface_t *QuanTermApp::LoadImageSurface(const std::string& name, const std::string& path)
+{
+  const PageBundleFormat::Image *img = m_bundle.FindImage(name.c_str());
+  if(img) {
+    // cairo only ever reads from a source surface so it can sit directly on the read-only mapping.
+    return cairo_image_surface_create_for_data((unsigned char *)m_bundle.GetImagePixels(img), CAIRO_FORMAT_ARGB32,
+					       img->m_width, img->m_height, img->m_stride);
+  }
+  return cairo_image_surface_create_from_png(path.c_str());
+}
+
+/// Renders a single text line
+void QuanTermApp::RenderText(std::string_view curText, size_t hiddenLen)
+{
+  if(curText.length() <= hiddenLen)
+    return;
+  
+  if(!m_bold && !m_image && !m_heading && m_preformat == PREFORMAT_OFF) {
+    m_ypos = ShowWrappedText(curText, curText.length() - hiddenLen, m_xpos, m_ypos, DisplayInst().GetScreenWidth() - (m_pageCfg.MarginX * 2));
+    m_xpos = m_pageCfg.MarginX;    
+    return;
+  }
+
+  QT_SCOPED_TIMER(TIMER_DRAW);
+  cairo_text_extents_t heightExtents;
+  cairo_text_extents(CairoInst(), "My", &heightExtents);
+  heightExtents.height += 4.0;  
+  
+  cairo_select_font_face (CairoInst(), "monospace", CAIRO_FONT_SLANT_NORMAL, m_bold ? CAIRO_FONT_WEIGHT_BOLD : CAIRO_FONT_WEIGHT_NORMAL);
+  cairo_set_font_size(CairoInst(), m_heading ? m_pageCfg.FontSizeHeading : m_pageCfg.FontSizeNormal);
+
+  // a heading is centred by its full length so it doesn't slide about as it is revealed.
+  cairo_text_extents_t extents;
+  cairo_text_extents(CairoInst(), m_frameArena.CStr(curText), &extents);
+  int tx = m_heading ? (DisplayInst().GetScreenWidth() - extents.width) / 2 : m_xpos;
+
+  const char *text = m_frameArena.CStr(curText.substr(0, curText.length() - hiddenLen));
+  if(hiddenLen)
+    cairo_text_extents(CairoInst(), text, &extents);
+
+  cairo_rectangle(CairoInst(), tx, m_ypos - extents.height +2, extents.width, extents.height);    
+  cairo_set_source_rgb(CairoInst(), m_pageCfg.TextBackgroundColour);
+  cairo_fill(CairoInst());
+  
+  cairo_move_to(CairoInst(), tx , m_ypos);
+  cairo_set_source_rgb(CairoInst(), m_pageCfg.TextColour);
+  cairo_show_text(CairoInst(), text);
+  m_xpos = m_pageCfg.MarginX;
+  m_ypos += heightExtents.height;
+}
+
+/// Renders an image, loading it if needs be, cached the last loaded image.
+void QuanTermApp::RenderImage(std::string_view curText)
+{
+  static std::string currentImageFile;
+  static cairo_surface_t *currentImageData = nullptr;
+    
+  if(!curText.length())
+    return;
+
+  QT_SCOPED_TIMER(TIMER_IMAGE);
+  
+  if(curText != currentImageFile) {
+    if(currentImageData) {
+      cairo_surface_destroy(currentImageData);
+      currentImageFile = "";
+    }
+    currentImageFile = curText;
+    currentImageData = LoadImageSurface(currentImageFile, m_pagesRoot + "/" + currentImageFile);
+    ++m_loadEpoch;
+
+    if(!currentImageData)
+      currentImageData = LoadImageSurface("logo.png", "logo.png");
+  }
+    
+  if(currentImageData) {
+    cairo_surface_t *imageData = currentImageData;
+    cairo_save(CairoInst());	
+    double height = cairo_image_surface_get_height(imageData);
+    double width = cairo_image_surface_get_width(imageData);
+    double aspect = height / width;
+    double targetWidth = DisplayInst().GetScreenWidth() - (m_pageCfg.MarginX * 2);
+    double targetHeight = targetWidth * aspect;
+    cairo_surface_set_device_scale(imageData, width / targetWidth, height / targetHeight);
+    cairo_set_source_surface(CairoInst(), imageData, m_xpos, m_ypos);
+    cairo_paint(CairoInst());
+
+    cairo_rectangle(CairoInst(), m_xpos-1, m_ypos-1, targetWidth+1, targetHeight+1);    
+    cairo_set_source_rgb(CairoInst(), m_pageCfg.ImageBorderColour);
+    cairo_stroke(CairoInst());	  
+
+    m_ypos += targetHeight;
+    cairo_restore(CairoInst());
+  }
+  
+  m_xpos = m_pageCfg.MarginX;
+  m_ypos += m_pageCfg.CharHeight;
+}
+
+/// Renders a page onto the screen. The token stream is largely streamable so its possible to stop
+/// at any point. 'howmuch' controls how many characters from content are rendered, this allows then
+/// it to be animated simulating a slow update like on an old 8bit machine.
+void QuanTermApp::RenderPageContent(const PageDocument& page, int howMuch)
+{
+  m_xpos = m_pageCfg.MarginX;
+  m_ypos = m_pageCfg.MarginY;
+  m_bold = false;
+  m_heading = false;
+  m_image = false;
+  m_preformat = PREFORMAT_OFF;
+
+  const char *content = page.GetContent();
+  const PageToken *tokens = page.GetTokens();
+  const uint32_t endPos = std::max(howMuch, 0);
+  
+  // the gathered text is never longer than the content it came from.
+  char *textBuf = m_frameArena.AllocChars(page.GetLength() + 1);
+  size_t textLen = 0;
+  auto curText = [&]() { return std::string_view(textBuf, textLen); };
+  // a span the reveal stops part way through is gathered whole so its words are laid out by
+  // their full length, this much of it is left undrawn. Nothing comes after such a span.
+  size_t hiddenLen = 0;
+  
+  for(uint32_t n = 0; n<page.GetTokenCount() && tokens[n].m_pos < endPos; n++) {
+    const PageToken& tok = tokens[n];
+    switch(tok.m_type) {
+    case PageToken::TEXT:
+      memcpy(textBuf + textLen, content + tok.m_pos, tok.m_len);
+      textLen += tok.m_len;
+      hiddenLen = tok.m_len - std::min(tok.m_len, endPos - tok.m_pos);
+      break;
+    case PageToken::SPACE:
+      textBuf[textLen++] = ' ';
+      break;
+    case PageToken::NEWLINE:
+      textBuf[textLen++] = '\n';
+      break;
+    case PageToken::BREAK:
+      RenderText(curText());
+      textLen = 0;
+      break;
+    case PageToken::BOLD:
+      RenderText(curText());
+      textLen = 0;
+      m_bold = !m_bold;
+      break;
+    case PageToken::HEADING:
+      RenderText(curText());
+      textLen = 0;
+      m_heading = !m_heading;      
+      break;
+    case PageToken::IMAGE_START:
+      RenderText(curText());
+      textLen = 0;
+      m_image = true;
+      break;
+    case PageToken::IMAGE_END:
+      RenderImage(curText());
+      textLen = 0;
+      m_image = false;
+      break;
+    case PageToken::PREFORMAT_START:
+      m_preformat = PREFORMAT_STORE;
+      break;
+    case PageToken::PREFORMAT_END:
+      m_preformat = PREFORMAT_OUTPUT;
+      RenderText(curText());
+      m_preformat = PREFORMAT_OFF;
+      textLen = 0;
+      break;
+    }
+  }
+
+  if(!m_image)
+    RenderText(curText(), hiddenLen);
+}
+
+/// Renders one button into a strip, which covers the button's cell of the margin and is the same
+/// whichever side the button is on.
+void QuanTermApp::RenderButtonStrip(ButtonStrip& strip, const ButtonData& btnData)
+{
+  ++m_stripRenders;
+  const int cellWidth = m_pageCfg.MarginX;
+  const int cellHeight = m_pageCfg.ButtonHeight * 2;
+  strip.m_caption = btnData.m_caption;
+  strip.m_pixels.assign(cellWidth * cellHeight, 0xff000000);
+  
+  cairo_surface_t *surface = cairo_image_surface_create_for_data((unsigned char *)&strip.m_pixels[0], CAIRO_FORMAT_ARGB32,
+								 cellWidth, cellHeight, cellWidth * 4);
+  {
+    ScopedCairoTarget target(surface);
+    cairo_select_font_face (CairoInst(), "monospace", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+    cairo_set_font_size(CairoInst(), m_pageCfg.FontSizeNormal);
+    cairo_set_source_rgb(CairoInst(), m_pageCfg.ButtonColour);
+    
+    int xpos = m_pageCfg.ButtonBorder;
+    int ypos = (m_pageCfg.ButtonHeight/2) + m_pageCfg.ButtonBorder;
+    int xsize = m_pageCfg.MarginX - (m_pageCfg.ButtonBorder * 2);
+    int ysize = m_pageCfg.ButtonHeight - (m_pageCfg.ButtonBorder * 2);
+    {
+      QT_SCOPED_TIMER(TIMER_DRAW);
+      cairo_rounded_rectangle(xpos, ypos, xsize, ysize);
+      cairo_stroke(CairoInst());
+    }
+
+    const std::string_view caption = btnData.m_caption;
+    int textWidth, textHeight;
+    SizeTextMultiline(caption, textWidth, textHeight); 
+    ShowTextMultiline(caption, xpos + (xsize - textWidth) / 2, ypos + (ysize/2) - (textHeight / 2));
+  }
+  cairo_surface_destroy(surface);
+}
+
+void QuanTermApp::BlitToCairoTarget(const uint32_t *pixels, int width, int height, int x, int y)
+{
+  cairo_surface_t *target = cairo_get_target(CairoInst());
+  cairo_surface_flush(target);
+  
+  if(cairo_image_surface_get_data(target) == (unsigned char *)DisplayInst().GetSurfacePtr()) {
+    DisplayInst().BlitImage32BitColor(pixels, width * 4, width, height, x, y);
+    cairo_surface_mark_dirty_rectangle(target, x, y, width, height);
+    return;
+  }
+
+  // somewhere off screen such as a prerendered page.
+  cairo_surface_t *source = cairo_image_surface_create_for_data((unsigned char *)pixels, CAIRO_FORMAT_ARGB32,
+								width, height, width * 4);
+  cairo_save(CairoInst());
+  cairo_set_operator(CairoInst(), CAIRO_OPERATOR_SOURCE);
+  cairo_set_source_surface(CairoInst(), source, x, y);
+  cairo_rectangle(CairoInst(), x, y, width, height);
+  cairo_fill(CairoInst());
+  cairo_restore(CairoInst());
+  cairo_surface_destroy(source);
+}
+
+/// Render the buttons down the side of the screen. Each slot keeps its button rendered in a strip
+/// and only redraws it when the caption changes, otherwise it is just copied into place.
+void QuanTermApp::RenderSideButtons(const std::vector<ButtonData>& buttons, bool keepStrips)
+{
+  // the page text that follows measures its line height before choosing a font, so leave the
+  // same font selected as drawing the buttons directly did.
+  cairo_select_font_face (CairoInst(), "monospace", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+  cairo_set_font_size(CairoInst(), m_pageCfg.FontSizeNormal);
+  cairo_set_source_rgb(CairoInst(), m_pageCfg.ButtonColour);
+
+  const int cellWidth = m_pageCfg.MarginX;
+  const int cellHeight = m_pageCfg.ButtonHeight * 2;
+  if(cellWidth <= 0 || cellHeight <= 0)
+    return;
+  
+  for(int s = 0; s<2; s++) {
+    for(int n = 0; n<4; n++) {
+      size_t idx = (s * 4) + n;
+      if(idx >= buttons.size())
+	return;
+      if(buttons[idx].m_caption == "---")
+	continue;
+
+      // a button that isn't kept is drawn in the scratch strip, leaving the slot to the screen's button.
+      ButtonStrip *strip = &m_buttonStrips[idx];
+      if(strip->m_caption != buttons[idx].m_caption || strip->m_pixels.size() != size_t(cellWidth * cellHeight)) {
+	if(!keepStrips)
+	  strip = &m_scratchStrip;
+	RenderButtonStrip(*strip, buttons[idx]);
+      }
+      BlitToCairoTarget(&strip->m_pixels[0], cellWidth, cellHeight,
+			s ? DisplayInst().GetScreenWidth() - cellWidth : 0, n * cellHeight);
+    }
+  }
+}
+
+bool QuanTermApp::LoadNewPage(const std::string& filename)
+{
+  auto it = std::find_if(m_prerendered.begin(), m_prerendered.end(), [&](const auto& pre) {
+    return pre->m_name == filename;
+  });
+
+  // with the typewriter effect effectively off the prerendered page can be shown as is.
+  if(it != m_prerendered.end() && !(*it)->m_pixels.empty() && m_pageCfg.ScrollSpeed >= (*it)->m_page.GetLength()) {
+    // move it to the most recently used end.
+    std::rotate(it, it + 1, m_prerendered.end());
+    const PrerenderedPage& pre = *m_prerendered.back();
+    
+    DisplayInst().VideoStop();
+    m_wantVideoStop = false;
+    m_pageData = pre.m_page;
+    m_buttons = pre.m_buttons;
+    m_pageLen = m_pageData.GetLength();
+    m_pageProgress = m_pageLen;
+    ++m_loadEpoch;
+    DestroyScrollSurface();
+
+    m_pageName = filename;
+    ShowPrerenderedPage(&pre.m_pixels[0]);
+    if(pre.m_contentHeight > DisplayInst().GetScreenHeight())
+      CreateScrollSurface(pre.m_contentHeight + m_pageCfg.MarginY);
+    return true;
+  }
+  
+  m_pageData.Clear();
+
+  // the first time the index is wanted it has already been read during startup.
+  if(m_indexLoad.valid() && filename == "index.txt" && m_indexLoad.get()) {
+    m_pageData = m_indexPage;
+    m_buttons = m_indexButtons;
+  } else if(!ReadPageData(filename, m_pageData, m_buttons)) {
+    return false;
+  }
+  m_pageName = filename;
+  DisplayInst().VideoStop();
+  m_wantVideoStop = false;
+  m_pageLen = m_pageData.GetLength();
+  ++m_loadEpoch;
+  m_pageProgress = 0;  
+  DestroyScrollSurface();
+  
+  DisplayInst().Clear();
+  RenderSideButtons(m_buttons);
+  cairo_surface_flush(cairo_get_target(CairoInst()));
+  DisplayInst().Present();  
+  return true;
+}
+
+void QuanTermApp::NavigateTo(const std::string& filename)
+{
+  std::unique_ptr<BackPage> back(new BackPage);
+  back->m_name = m_pageName;
+  back->m_page = m_pageData;
+  back->m_buttons = m_buttons;
+  // the back buffer only holds the page, a playing video is on the front buffer alone.
+  if(m_pageProgress == m_pageLen) {
+    const int stride = DisplayInst().GetStride();
+    const size_t count = size_t(stride / 4) * DisplayInst().GetScreenHeight();
+    EncodePixelRuns((const uint32_t *)DisplayInst().GetSurfacePtr(), count, back->m_runs);
+    back->m_runs.shrink_to_fit();
+    if(m_scrollSurface) {
+      back->m_scrollHeight = cairo_image_surface_get_height(m_scrollSurface);
+      back->m_scrollY = m_scrollY;
+    }
+  }
+
+  if(!LoadNewPage(filename) || back->m_name.empty())
+    return;
+
+  m_backStackBytes += back->m_runs.size() * sizeof(uint32_t);
+  m_backStack.push_back(std::move(back));
+
+  // the oldest go first, a screen too big for the budget on its own is dropped and reloaded instead.
+  const size_t maxPages = std::max(1, int(m_pageCfg.BackPages));
+  const size_t maxBytes = size_t(std::max(0.0, m_pageCfg.BackMemoryKB) * 1024);
+  while(m_backStack.size() > maxPages || (m_backStackBytes > maxBytes && m_backStack.size() > 1)) {
+    m_backStackBytes -= m_backStack.front()->m_runs.size() * sizeof(uint32_t);
+    m_backStack.erase(m_backStack.begin());
+  }
+  if(m_backStackBytes > maxBytes) {
+    std::vector<uint32_t>().swap(m_backStack.back()->m_runs);
+    m_backStackBytes = 0;
+  }
+}
+
+bool QuanTermApp::GoBack()
+{
+  if(m_backStack.empty())
+    return false;
+
+  std::unique_ptr<BackPage> back = std::move(m_backStack.back());
+  m_backStack.pop_back();
+  m_backStackBytes -= back->m_runs.size() * sizeof(uint32_t);
+  if(back->m_runs.empty())
+    return LoadNewPage(back->m_name);
+
+  const int stride = DisplayInst().GetStride();
+  const size_t count = size_t(stride / 4) * DisplayInst().GetScreenHeight();
+  // the screen size can't have changed, but a bad snapshot is better reloaded than shown.
+  uint32_t *pixels = (uint32_t *)DisplayInst().GetSurfacePtr();
+  if(!DecodePixelRuns(&back->m_runs[0], back->m_runs.size(), pixels, count)) {
+    printf("Back page '%s' didn't decode\n", back->m_name.c_str());
+    return LoadNewPage(back->m_name);
+  }
+  
+  DisplayInst().VideoStop();
+  m_wantVideoStop = false;
+  m_pageName = back->m_name;
+  m_pageData = std::move(back->m_page);
+  m_buttons = std::move(back->m_buttons);
+  m_pageLen = m_pageData.GetLength();
+  m_pageProgress = m_pageLen;
+  ++m_loadEpoch;
+  DestroyScrollSurface();
+
+  DisplayInst().MarkContent(DisplayInst().GetScreenRect());
+  DisplayInst().Present();
+
+  // the screen is back already, scrolling has to wait for the long page to be rendered again.
+  if(back->m_scrollHeight > 0) {
+    CreateScrollSurface(back->m_scrollHeight);
+    if(m_scrollSurface) {
+      const int maxScroll = std::max(0, cairo_image_surface_get_height(m_scrollSurface) - DisplayInst().GetScreenHeight());
+      m_scrollY = m_scrollTarget = std::min(back->m_scrollY, maxScroll);
+    }
+  }
+  return true;
+}
+
+void QuanTermApp::ClearBackStack()
+{
+  m_backStack.clear();
+  m_backStackBytes = 0;
+}
+
+std::string_view QuanTermApp::GetPageLink(std::string_view cmd)
+{
+  static constexpr std::string_view NavigateCmd = "navigate:";
+  if(cmd.substr(0, NavigateCmd.size()) == NavigateCmd)
+    return cmd.substr(NavigateCmd.size());
+  if(cmd.size() >= 4 && strncasecmp(cmd.data() + cmd.size() - 4, ".txt", 4) == 0)
+    return cmd;
+  return std::string_view();
+}
+
+void QuanTermApp::RenderCurrentPage()
+{
+  if(m_pageProgress == m_pageLen) {
+    // the buttons haven't changed since the page was loaded, only the column the page is revealed into is redrawn.
+    DisplayInst().Clear(GetContentColumn());
+    
+    // a long page is already rendered, it only needs copying.
+    if(m_scrollSurface) {
+      RenderScrollView();
+      DisplayInst().Present();
+      return;
+    }
+  }
+  
+  RenderPageContent(m_pageData, m_pageProgress);
+  cairo_surface_flush(cairo_get_target(CairoInst()));
+  // everything is drawn above m_ypos apart from the last line's descenders.
+  DisplayInst().MarkContent(FBRect{0, 0, DisplayInst().GetScreenWidth(), m_ypos + int(m_pageCfg.FontSizeHeading)});
+
+  // the page didn't fit so render it all off screen ready for scrolling
+  if(m_pageProgress == m_pageLen && !m_scrollSurface && m_ypos > DisplayInst().GetScreenHeight())
+    CreateScrollSurface(m_ypos + m_pageCfg.MarginY);
+  
+  DisplayInst().Present();    
+}
+
+FBRect QuanTermApp::GetContentColumn() const
+{
+  // the image border sits just outside the margin.
+  constexpr int ImageBorder = 2;
+  const int x = std::max(0, int(m_pageCfg.MarginX) - ImageBorder);
+  return FBRect{x, 0, DisplayInst().GetScreenWidth() - (x * 2), DisplayInst().GetScreenHeight()};
+}
+
+void QuanTermApp::CreateScrollSurface(int pageHeight)
+{
+  DestroyScrollSurface();
+
+  const FBRect column = GetContentColumn();
+  m_scrollX = column.m_x;
+  const int width = column.m_width;
+  // don't let a runaway page eat all the memory.
+  const int height = std::min(pageHeight, DisplayInst().GetScreenHeight() * 8);
+  if(width <= 0)
+    return;
+  
+  m_scrollSurface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+  if(cairo_surface_status(m_scrollSurface) != CAIRO_STATUS_SUCCESS) {
+    printf("Failed to create a %i x %i scroll surface\n", width, height);
+    DestroyScrollSurface();
+    return;
+  }
+
+  {
+    ScopedCairoTarget target(m_scrollSurface);
+    cairo_set_source_rgb(CairoInst(), 0.0, 0.0, 0.0);
+    cairo_paint(CairoInst());
+    cairo_translate(CairoInst(), -m_scrollX, 0);
+    RenderPageContent(m_pageData, m_pageLen);
+  }
+
+  m_scrollY = 0;
+  m_scrollTarget = 0;
+  ++m_loadEpoch;
+  printf("Long page, scroll surface %i x %i\n", width, height);
+}
+
+void QuanTermApp::DestroyScrollSurface()
+{
+  if(m_scrollSurface)
+    cairo_surface_destroy(m_scrollSurface);
+  m_scrollSurface = nullptr;
+  m_scrollY = 0;
+  m_scrollTarget = 0;
+}
+
+void QuanTermApp::RenderScrollView()
+{
+  const uint32_t *src = (const uint32_t *)cairo_image_surface_get_data(m_scrollSurface);
+  const int stride = cairo_image_surface_get_stride(m_scrollSurface);
+  src = (const uint32_t *)((const char *)src + (m_scrollY * stride));
+  const int height = std::min(DisplayInst().GetScreenHeight(), cairo_image_surface_get_height(m_scrollSurface) - m_scrollY);
+  DisplayInst().BlitImage32BitColor(src, stride, cairo_image_surface_get_width(m_scrollSurface), height, m_scrollX, 0);
+}
+
+void QuanTermApp::StepScroll()
+{
+  if(!m_scrollSurface)
+    return;
+
+  const int step = std::max(1, int(m_pageCfg.PageScrollSpeed));
+  const int dy = std::max(-step, std::min(step, m_scrollTarget - m_scrollY));
+  m_scrollY += dy;
+
+  // shift what's already on screen and copy in just the strip that has come into view.
+  const int screenHeight = DisplayInst().GetScreenHeight();
+  const int width = cairo_image_surface_get_width(m_scrollSurface);
+  DisplayInst().ScrollRegion(m_scrollX, 0, width, screenHeight, dy);
+
+  const int stride = cairo_image_surface_get_stride(m_scrollSurface);
+  const char *data = (const char *)cairo_image_surface_get_data(m_scrollSurface);
+  const int stripHeight = std::min(abs(dy), screenHeight);
+  const int stripY = dy > 0 ? screenHeight - stripHeight : 0;
+  DisplayInst().BlitImage32BitColor((const uint32_t *)(data + ((m_scrollY + stripY) * stride)), stride, width, stripHeight, m_scrollX, stripY);
+  
+  DisplayInst().Present();
+}
+
+bool QuanTermApp::PrerenderNextPage()
+{
+  const size_t maxPages = std::max(0, int(m_pageCfg.PrerenderPages));
+  if(maxPages == 0)
+    return false;
+  
+  auto IsPrerendered = [&](std::string_view name) {
+    for(const auto& pre : m_prerendered) {
+      if(pre->m_name == name)
+	return true;
+    }
+    return false;
+  };
+  
+  auto IsLinked = [&](std::string_view name) {
+    for(const auto& btn : m_buttons) {
+      if(GetPageLink(btn.m_cmd) == name)
+	return true;
+    }
+    return false;
+  };
+  
+  for(const auto& btn : m_buttons) {
+    const std::string_view cmd = GetPageLink(btn.m_cmd);
+    if(cmd.empty() || IsPrerendered(cmd))
+      continue;
+
+    // make room, but never by throwing out another page this one links to.
+    if(m_prerendered.size() >= maxPages) {
+      auto victim = std::find_if(m_prerendered.begin(), m_prerendered.end(), [&](const auto& pre) {
+	return !IsLinked(pre->m_name);
+      });
+      if(victim == m_prerendered.end())
+	return false;
+      m_prerendered.erase(victim);
+    }
+
+    std::unique_ptr<PrerenderedPage> pre(new PrerenderedPage);
+    pre->m_name = cmd;
+    if(!ReadPageData(pre->m_name, pre->m_page, pre->m_buttons)) {
+      // keep the empty entry so the failure isn't retried every frame.
+      m_prerendered.push_back(std::move(pre));
+      return true;
+    }
+
+    const int width = DisplayInst().GetScreenWidth();
+    const int height = DisplayInst().GetScreenHeight();
+    pre->m_pixels.resize(width * height);
+    cairo_surface_t *surface = cairo_image_surface_create_for_data((unsigned char *)&pre->m_pixels[0], CAIRO_FORMAT_ARGB32,
+								   width, height, width * 4);
+    {
+      ScopedCairoTarget target(surface);
+      cairo_set_source_rgb(CairoInst(), 0.0, 0.0, 0.0);
+      cairo_paint(CairoInst());
+      RenderSideButtons(pre->m_buttons, false);
+      RenderPageContent(pre->m_page, pre->m_page.GetLength());
+      pre->m_contentHeight = m_ypos;
+    }
+    cairo_surface_destroy(surface);
+
+    printf("Prerendered '%s'\n", pre->m_name.c_str());
+    m_prerendered.push_back(std::move(pre));
+    ++m_loadEpoch;
+    return true;
+  }
+  
+  return false;
+}
+
+void QuanTermApp::ShowPrerenderedPage(const uint32_t *pixels)
+{
+  const int width = DisplayInst().GetScreenWidth();
+  const int height = DisplayInst().GetScreenHeight();
+  const int stride = width * 4;
+  const int frames = std::max(1, int(m_pageCfg.PageTransitionFrames));
+  constexpr useconds_t FrameMicros = 1000000 / 60;
+  
+  if(int(m_pageCfg.PageTransition) == TRANSITION_WIPE) {
+    // reveal the new page top to bottom, a band of rows at a time.
+    int done = 0;
+    for(int f = 1; f<=frames; f++) {
+      const int rows = (height * f) / frames;
+      DisplayInst().BlitImage32BitColor(pixels + (done * width), stride, width, rows - done, 0, done);
+      DisplayInst().Present();
+      done = rows;
+      usleep(FrameMicros);
+    }
+    return;
+  }
+
+  if(int(m_pageCfg.PageTransition) == TRANSITION_SLIDE) {
+    // push the old page up and off the screen with the new one following it.
+    int done = 0;
+    for(int f = 1; f<=frames; f++) {
+      const int rows = (height * f) / frames;
+      const int step = rows - done;
+      DisplayInst().ScrollRegion(0, 0, width, height, step);
+      DisplayInst().BlitImage32BitColor(pixels + (done * width), stride, width, step, 0, height - step);
+      DisplayInst().Present();
+      done = rows;
+      usleep(FrameMicros);
+    }
+    return;
+  }
+
+  DisplayInst().BlitImage32BitColor(pixels, stride, width, height, 0, 0);
+  DisplayInst().Present();
+}
+
+void QuanTermApp::HandleButtonPress(int n, const std::vector<ButtonData>& buttons)
+{
+  if(n < 0)
+    return;
+  if(n >= (int)buttons.size())
+    return;
+
+  const auto& cmd = buttons[n].m_cmd;
+  static constexpr std::string_view PlaylistCmd = "playlist:";
+  if(std::string_view(cmd).substr(0, PlaylistCmd.size()) == PlaylistCmd) {
+    m_pageProgress = m_pageLen;
+    RenderCurrentPage();
+    PlayVideoList(std::string_view(cmd).substr(PlaylistCmd.size()));
+    return;
+  }
+
+  const std::string_view link = GetPageLink(cmd);
+  if(!link.empty()) {
+    NavigateTo(std::string(link));
+    return;
+  }
+  
+  auto dotPos = cmd.rfind('.');
+  if(dotPos <= 0 || dotPos == std::string::npos) {
+    if(cmd == "video_stop")  {
+      // the video was a layer over the page, which comes back with the next present.
+      m_wantVideoStop = false;
+      DisplayInst().VideoStop();
+      DisplayInst().Present();
+    } else if(cmd == "back") {
+      GoBack();
+    } else if(cmd == "scroll_up" || cmd == "scroll_down") {
+      if(m_scrollSurface) {
+	const int maxScroll = std::max(0, cairo_image_surface_get_height(m_scrollSurface) - DisplayInst().GetScreenHeight());
+	const int step = cmd == "scroll_up" ? -m_pageCfg.PageScrollStep : m_pageCfg.PageScrollStep;
+	m_scrollTarget = std::max(0, std::min(maxScroll, m_scrollTarget + step));
+      }
+    }
+  } else {
+    std::string ext = cmd.substr(dotPos, std::string::npos);
+    LogMessage(LOG_LEVEL_DEBUG, "%s\n", ext.c_str());
+    for(auto& c : ext)
+      c = std::tolower(c);
+    if(ext == ".mp4") {
+      // force the page load animation to finish so it doesn't interfere with the video.
+      m_pageProgress = m_pageLen;
+      RenderCurrentPage();    
+      DisplayInst().VideoPlay((m_pagesRoot + "/" + cmd).c_str());
+    }
+  }
+}
+
+class AttractorLogoSprite {
+public:
+  AttractorLogoSprite(const double sizeScale, const double alpha);  
+  void Render(cairo_surface_t *logoImg, const double elapsed);
+
+  double RandomSpeed(double direction) {
+    return RandFloat(150, 200) * m_sizeScale * (direction > 0.0 ? 1.0 : -1.0);
+  }
+
+  double RandomSpeed() {
+    return RandomSpeed(RandFloat(-1.0, 1.0));
+  }
+  
+protected:
+  /// the sprite never changes size so the logo is scaled once and then composited directly.
+  void PrepareScaled(cairo_surface_t *logoImg);
+  
+  double m_xpos;
+  double m_ypos;
+  double m_speedx;
+  double m_speedy;
+  double m_sizeScale;
+  double m_alpha;
+  std::vector<uint32_t> m_scaled;
+  int m_scaledWidth = 0;
+  int m_scaledHeight = 0;
+};
+
+AttractorLogoSprite::AttractorLogoSprite(const double sizeScale, const double alpha)
+  : m_xpos((DisplayInst().GetScreenWidth()/2) + RandFloat(100, DisplayInst().GetScreenWidth() / 4)),
+    m_ypos((DisplayInst().GetScreenHeight()/2) + RandFloat(100, DisplayInst().GetScreenHeight() / 4)),
+    m_sizeScale(sizeScale),
+    m_alpha(alpha)
+{
+  m_speedx = RandomSpeed();
+  m_speedy = RandomSpeed();
+}
+
+void AttractorLogoSprite::PrepareScaled(cairo_surface_t *logoImg)
+{
+  const double height = cairo_image_surface_get_height(logoImg);
+  const double width = cairo_image_surface_get_width(logoImg);
+  const double targetWidth = DisplayInst().GetScreenWidth() * m_sizeScale;
+  const double targetHeight = targetWidth * (height / width);
+  
+  m_scaledWidth = std::max(1, int(std::ceil(targetWidth)));
+  m_scaledHeight = std::max(1, int(std::ceil(targetHeight)));
+  m_scaled.assign(m_scaledWidth * m_scaledHeight, 0);
+  
+  cairo_surface_t *surface = cairo_image_surface_create_for_data((unsigned char *)&m_scaled[0], CAIRO_FORMAT_ARGB32,
+								 m_scaledWidth, m_scaledHeight, m_scaledWidth * 4);
+  cairo_t *cr = cairo_create(surface);
+  cairo_scale(cr, targetWidth/width, targetHeight/height);
+  cairo_set_source_surface(cr, logoImg, 0, 0);
+  cairo_paint(cr);
+  cairo_destroy(cr);
+  cairo_surface_destroy(surface);
+}
+
+void AttractorLogoSprite::Render(cairo_surface_t *logoImg, const double elapsedTime)
+{
+  if(m_scaled.empty())
+    PrepareScaled(logoImg);
+  
+  double targetWidth2 = m_scaledWidth / 2.0;
+  double targetHeight2 = m_scaledHeight / 2.0;
+
+  DisplayInst().CompositeImage(&m_scaled[0], m_scaledWidth * 4, m_scaledWidth, m_scaledHeight,
+			       int(m_xpos - targetWidth2), int(m_ypos - targetHeight2), int(m_alpha * 255.0 + 0.5));
+
+  double rightEdge = DisplayInst().GetScreenWidth() - targetWidth2;
+  double leftEdge = targetWidth2;
+  double bottomEdge = DisplayInst().GetScreenHeight() - targetHeight2;
+  double topEdge = targetHeight2;
+  
+  m_xpos += m_speedx * elapsedTime;
+  m_ypos += m_speedy * elapsedTime;
+
+  if(m_xpos > rightEdge) {
+    m_speedx = RandomSpeed(-m_speedx);
+    m_xpos = rightEdge;
+  }
+  
+  if(m_xpos < leftEdge) {
+    m_speedx = RandomSpeed(-m_speedx);
+    m_xpos = leftEdge;
+  }
+
+  if(m_ypos > bottomEdge) {
+    m_speedy = RandomSpeed(-m_speedy);
+    m_ypos = bottomEdge;
+  }
+  
+  if(m_ypos < topEdge) {
+    m_speedy = RandomSpeed(-m_speedy);
+    m_ypos = topEdge;
+  }
+}
+
+ThreadPlacement QuanTermApp::GetThreadPlacement(double cpuMask) const
+{
+  ThreadPlacement placement;
+  placement.m_cpuMask = unsigned(cpuMask);
+  const int policy = int(m_pageCfg.RealtimePolicy);
+  placement.m_policy = policy == 1 ? SCHED_POLICY_FIFO : policy == 2 ? SCHED_POLICY_RR : SCHED_POLICY_NORMAL;
+  placement.m_priority = int(m_pageCfg.RealtimePriority);
+  return placement;
+}
+
+void QuanTermApp::ApplyThreadSettings()
+{
+  ApplyThreadPlacement(GetThreadPlacement(m_pageCfg.RenderCPUMask), "main loop");
+  DisplayInst().SetWorkerPlacement(GetThreadPlacement(m_pageCfg.WorkerCPUMask));
+  DisplayInst().SetVideoPlacement(GetThreadPlacement(m_pageCfg.VideoCPUMask));
+  if(m_pageCfg.LockBuffers != 0)
+    DisplayInst().LockBuffers();
+}
+
+void QuanTermApp::SleepDisplay()
+{
+  printf("Blanking the display until a button is pressed\n");
+  DisplayInst().VideoStop();
+  m_wantVideoStop = false;
+  DisplayInst().SetBlanked(true);
+  WaitForInput(-1);
+
+  // the last attractor frame is still in the back buffer, waking only has to show it again.
+  const double wakeStart = GetTimeMS();
+  DisplayInst().SetBlanked(false);
+  DisplayInst().PresentAll();
+  printf("Display woke in %.1fms\n", GetTimeMS() - wakeStart);
+}
+
+bool QuanTermApp::PlayVideoList(std::string_view list)
+{
+  std::vector<std::string> filenames;
+  while(!list.empty()) {
+    const size_t comma = std::min(list.find(','), list.size());
+    if(comma > 0)
+      filenames.push_back(m_pagesRoot + "/" + std::string(list.substr(0, comma)));
+    list.remove_prefix(std::min(comma + 1, list.size()));
+  }
+  if(filenames.empty())
+    return false;
+  return DisplayInst().VideoPlayList(filenames);
+}
+
+void QuanTermApp::RenderAttractorScreen()
+{
+  if(!m_logoImg) {
+    m_logoImg = m_logoLoad.valid() ? m_logoLoad.get() : LoadImageSurface("logo.png", "logo.png");
+  }
+    
+  cairo_surface_t *logoImg = m_logoImg;
+  if(!logoImg)
+    return;
+
+  // only last frame's sprites and text are cleared away, and only they and this frame's get presented.
+  DisplayInst().Clear();
+
+  // these are rendered in order so makre sure the smallest is first
+  static std::vector<AttractorLogoSprite> sprites = {
+    AttractorLogoSprite(0.2, 0.2),    
+    AttractorLogoSprite(0.2, 0.2),
+    AttractorLogoSprite(0.2, 0.2),
+    AttractorLogoSprite(0.3, 0.5),
+    AttractorLogoSprite(0.3, 0.5),
+    AttractorLogoSprite(0.4, 1.0)
+  };
+  
+  static double lastTime = GetTimeMS();
+  double elapsed = (GetTimeMS() - lastTime) / 1000.0;
+  lastTime = GetTimeMS();
+
+  QT_SCOPED_TIMER(TIMER_DRAW);
+  for(size_t n = 0; n<sprites.size(); n++)
+    sprites[n].Render(logoImg, elapsed);
+
+  auto& cr = CairoInst();    
+  cairo_surface_mark_dirty(cairo_get_target(cr));
+  cairo_select_font_face (cr, "monospace", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+  cairo_set_font_size(cr, m_pageCfg.FontSizeHeading);
+  const char *msg = "Press any button to start";
+  cairo_set_source_rgb(cr, m_pageCfg.TextColour);
+  cairo_text_extents_t extents;
+  cairo_text_extents(cr, msg, &extents);
+  
+  int x = (DisplayInst().GetScreenWidth() - extents.width) / 2;
+  int y = DisplayInst().GetScreenHeight() - extents.height - 30;
+  cairo_move_to(cr, x, y);
+  cairo_set_source_rgb(cr, m_pageCfg.TextColour);  
+  cairo_show_text(cr, msg);
+  // a pixel extra all round for the antialiasing.
+  DisplayInst().MarkContent(FBRect{x + int(std::floor(extents.x_bearing)) - 1, y + int(std::floor(extents.y_bearing)) - 1,
+				   int(std::ceil(extents.width)) + 3, int(std::ceil(extents.height)) + 3});
+  
+  DisplayInst().Present();
+}
+
+void QuanTermApp::StartBackgroundLoads()
+{
+  m_logoLoad = std::async(std::launch::async, [this]() {
+    return LoadImageSurface("logo.png", "logo.png");
+  });
+  m_indexLoad = std::async(std::launch::async, [this]() {
+    return ReadPageData("index.txt", m_indexPage, m_indexButtons);
+  });
+  m_fontWarmUp = std::async(std::launch::async, [this]() {
+    WarmFontCache();
+  });
+}
+
+void QuanTermApp::WarmFontCache()
+{
+  // a context of its own as they can't be shared between threads, the font and glyph caches behind them are.
+  cairo_surface_t *surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 64, 64);
+  cairo_t *cr = cairo_create(surface);
+
+  char glyphs[128 - ' '];
+  for(int c = ' '; c<127; c++)
+    glyphs[c - ' '] = c;
+  glyphs[127 - ' '] = 0;
+
+  for(cairo_font_weight_t weight : {CAIRO_FONT_WEIGHT_NORMAL, CAIRO_FONT_WEIGHT_BOLD}) {
+    for(double size : {m_pageCfg.FontSizeNormal, m_pageCfg.FontSizeHeading}) {
+      cairo_select_font_face(cr, "monospace", CAIRO_FONT_SLANT_NORMAL, weight);
+      cairo_set_font_size(cr, size);
+      cairo_move_to(cr, 0, size);
+      cairo_show_text(cr, glyphs);
+    }
+  }
+
+  cairo_destroy(cr);
+  cairo_surface_destroy(surface);
+}
+
+int QuanTermApp::AppMain()
+{
+  double startTime = GetTimeMS();
+
+  // the LED self-test and libvlc take seconds to get going so they start first and carry on alongside everything else.
+  StartGPIO();
+  DisplayInst().StartVideoInit();
+  
+  // Open the framebuffer
+  if(!DisplayInst().Open()) {
+    printf("Failed to open framebuffer\n");
+    return 0;
+  }
+  
+  printf("Framebuffer: %i x %i\n", DisplayInst().GetScreenWidth(), DisplayInst().GetScreenHeight());
+
+  // the attractor as it was last time goes up before anything else is ready.
+  char splashFile[512];
+  snprintf(splashFile, sizeof(splashFile), "splash-%ix%ix%i.raw", DisplayInst().GetScreenWidth(), DisplayInst().GetScreenHeight(),
+	   DisplayInst().GetBitsPerPixel());
+  const bool haveSplash = DisplayInst().ShowSplash(splashFile);
+  if(haveSplash)
+    printf("Splash up after %.0fms\n", GetTimeMS() - startTime);
+
+  // load a page config that corresponds to the framebuffer resolution
+  char pcFile[512];
+  sprintf(pcFile, "page-config-%ix%i.txt", DisplayInst().GetScreenWidth(), DisplayInst().GetScreenHeight());
+  if(!m_pageCfg.LoadPageConfig(pcFile)) {
+    printf("Failed to load page config: %s\n", pcFile);
+    return false;
+  }
+
+  // set the video playback config
+  DisplayInst().SetVideoWindowX(m_pageCfg.MarginX);
+  DisplayInst().SetVideoWindowY(m_pageCfg.VideoPosY);
+  DisplayInst().SetVideoWindowWidth(DisplayInst().GetScreenWidth() - (m_pageCfg.MarginX * 2));
+  DisplayInst().SetVideoYUV(m_pageCfg.VideoYUV != 0);
+
+  StartBackgroundLoads();
+  // after the background loads have started so they don't inherit the main loop's placement.
+  ApplyThreadSettings();
+
+  // the splash covers the whole screen so it also clears away any terminal text, the first frame replaces it.
+  DisplayInst().Clear();
+  if(!haveSplash) {
+    const int r = 100;
+    const int hw = DisplayInst().GetScreenWidth() / 2;
+    const int hh = DisplayInst().GetScreenHeight() / 2;
+  
+    DisplayInst().FillCircle(hw - r, hh - r, r, 0xff0000ff);
+    DisplayInst().FillCircle(hw + r, hh - r, r, 0xff00ff00);
+    DisplayInst().FillCircle(hw + r, hh + r, r, 0xffff0000);
+    DisplayInst().FillCircle(hw - r, hh + r, r, 0xff888888);
+    DisplayInst().Present();    
+    DisplayInst().Clear();
+  }
+
+  cairo_surface_t *surface = cairo_image_surface_create_for_data((unsigned char *)DisplayInst().GetSurfacePtr(),
+								 CAIRO_FORMAT_ARGB32, 
+								 DisplayInst().GetScreenWidth(),
+								 DisplayInst().GetScreenHeight(),
+								 DisplayInst().GetStride());
+  CairoInst() = cairo_create(surface);
+
+
+  
+  bool quit = false;
+  bool idling = true;
+  double lastFrameTime = GetTimeMS();
+  // the idle timers go by the input's clock, which a replay speeds up along with the presses.
+  double lastIdleTime = TraceClockMS();
+  double idleStartTime = TraceClockMS();
+  bool splashSaved = haveSplash;
+  int attractorFrames = 0;
+
+  unsigned lastVideoFrameCount = DisplayInst().GetVideoFrameCount();
+  DisplayInst().SetVideoStopObserver([this](const VideoStats&) {
+    m_wantVideoStop = true;
+  });  
+
+  EnableRawMode();
+#ifdef QUANTERM_TIMING
+  InitPhaseTimers("quanterm-trace.json");
+#endif
+  
+  while(!quit) {
+#ifdef QUANTERM_TIMING
+    PollPhaseTimers();
+#endif
+    QT_SCOPED_TIMER(TIMER_FRAME);
+    m_frameArena.Reset();
+    SetGPIOAttractorState(idling, GetTimeMS());
+
+#ifdef QUANTERM_ALLOC_DEBUG
+    const size_t allocsBefore = GetHeapAllocCount();
+    const int epochBefore = m_loadEpoch;
+#endif
+    
+    bool limitFPS = true;
+    double frameTime = 1000.0 / 60.0;
+    if(idling) {
+      const double idleFor = (TraceClockMS() - idleStartTime) / 1000.0;
+      if(m_pageCfg.BlankSeconds > 0 && idleFor > m_pageCfg.BlankSeconds) {
+	SleepDisplay();
+	idleStartTime = TraceClockMS();
+	lastIdleTime = TraceClockMS();
+      }
+      
+      // the playlist attractor only needs starting, if it can't be the logo stands in.
+      static bool attractorVideoFailed = false;
+      if(!m_pageCfg.AttractorPlaylist.empty() && !attractorVideoFailed) {
+	if(!DisplayInst().IsVideoPlaying()) {
+	  DisplayInst().Clear(DisplayInst().GetScreenRect());
+	  DisplayInst().Present();
+	  attractorVideoFailed = !PlayVideoList(m_pageCfg.AttractorPlaylist);
+	}
+      } else {
+	RenderAttractorScreen();
+	// nobody has been by for a while so there's no need for smooth animation.
+	limitFPS = m_pageCfg.AttractorLowFPSSeconds > 0 && m_pageCfg.AttractorLowFPS > 0 && idleFor > m_pageCfg.AttractorLowFPSSeconds;
+	if(limitFPS)
+	  frameTime = 1000.0 / m_pageCfg.AttractorLowFPS;
+	// once the logos have had a moment to spread out the screen becomes the next start's splash.
+	constexpr int SplashFrame = 60;
+	if(!splashSaved && ++attractorFrames == SplashFrame) {
+	  DisplayInst().SaveSplash(splashFile);
+	  splashSaved = true;
+	  ++m_loadEpoch;
+	}
+      }
+      if(startTime >= 0.0) {
+	printf("First interactive frame after %.0fms\n", GetTimeMS() - startTime);
+	startTime = -1.0;
+      }
+    } else {
+      if(m_pageProgress < m_pageLen) {
+	m_pageProgress = std::min(m_pageLen, m_pageProgress+int(m_pageCfg.ScrollSpeed));
+	RenderCurrentPage();
+	limitFPS = false;
+      } else if(m_scrollY != m_scrollTarget) {
+	StepScroll();
+      } else if(!DisplayInst().IsVideoPlaying()) {
+	// nothing else to do so get the next pages ready.
+	PrerenderNextPage();
+      }
+    }
+
+#ifdef QUANTERM_ALLOC_DEBUG
+    // once nothing has been loaded for a few frames the reveal and attractor rendering must not allocate.
+    static int steadyFrames = 0;
+    if(m_loadEpoch == epochBefore && !m_frameArena.HasOverflowed())
+      ++steadyFrames;
+    else
+      steadyFrames = 0;
+    const size_t frameAllocs = GetHeapAllocCount() - allocsBefore;
+    if(steadyFrames > 2 && frameAllocs != 0) {
+      printf("%zu heap allocations in a steady state frame\n", frameAllocs);
+      assert(frameAllocs == 0);
+    }
+#endif
+
+    const double elapsed = GetTimeMS() - lastFrameTime;
+    if(elapsed < frameTime && limitFPS) {
+      QT_SCOPED_TIMER(TIMER_SLEEP);
+      // never longer than a frame, even if the clock went backwards.
+      const double toSleep = std::clamp(frameTime - elapsed, 0.0, frameTime);
+      // while idle a button cuts the sleep short.
+      if(idling)
+	WaitForInput(int(toSleep));
+      else
+	usleep(1000 * toSleep);
+    }
+    lastFrameTime = GetTimeMS();    
+
+    // a video someone chose to watch counts as activity, a looping playlist would never let the unit idle.
+    const unsigned videoFrameCount = DisplayInst().GetVideoFrameCount();
+    if(videoFrameCount != lastVideoFrameCount) {
+      lastVideoFrameCount = videoFrameCount;
+      if(!DisplayInst().IsVideoLooping())
+	lastIdleTime = TraceClockMS();
+    }
+
+    double idleTime = (TraceClockMS() - lastIdleTime) / 1000.0;
+    static constexpr int IdleCheckRate = 60;
+    static int lastIdleSecond = 0;
+    if(int(idleTime/IdleCheckRate) != lastIdleSecond) {
+      printf("Idle for %.02f / %.02f\n", idleTime, m_pageCfg.IdleTimeoutSeconds);
+      lastIdleSecond = int(idleTime/IdleCheckRate);
+    }
+    
+    if(idleTime > m_pageCfg.IdleTimeoutSeconds) {
+      // the attractor's own playlist keeps going while idle.
+      if(!idling) {
+	idleStartTime = TraceClockMS();
+	DisplayInst().VideoStop();
+	// the next visitor starts from the index.
+	ClearBackStack();
+	idling = true;
+      }
+      lastIdleTime = TraceClockMS();
+    }
+    
+    if(Kbhit()) {
+      static int kc = 0;
+      LogMessage(LOG_LEVEL_DEBUG, "Kb hit %i\n", kc++);
+      lastIdleTime = TraceClockMS();      
+      // held buttons have already had their repeats taken out.
+      char c = ReadChar();
+      if(c == 'q') {
+	quit = true;
+      } else if(c >= '1' && c <= '8') {
+	if(!idling) {
+	  int btn = c - '1';
+	  HandleButtonPress(btn, m_buttons);
+	} else {
+	  LoadNewPage("index.txt");
+	  idling = false;
+	}
+      }
+    }
+
+    if(m_wantVideoStop) {
+      m_wantVideoStop = false;
+      DisplayInst().VideoStop();
+      DisplayInst().Present();
+    }
+
+    if(IsInputReplayFinished()) {
+      printf("Input replay finished\n");
+      quit = true;
+    }
+  }
+  
+  StopInputTrace();
+  DisableRawMode();  
+#ifdef QUANTERM_TIMING
+  DumpPhaseTimers();
+#endif
+  
+  cairo_destroy(CairoInst());
+  cairo_surface_destroy(surface);
+  
+  return 0;
+}
@@ -0,0 +1,319 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/																																																	  
+#pragma once
+
+FBDisplay& DisplayInst();
+
+typedef cairo_t *CairoPtr;
+CairoPtr& CairoInst();
+
+/// Points CairoInst at another surface for the lifetime of the object, so the page
+/// rendering functions can be used to draw off screen.
+class ScopedCairoTarget {
+public:
+  ScopedCairoTarget(cairo_surface_t *surface) : m_saved(CairoInst()) {
+    CairoInst() = cairo_create(surface);
+  }
+  
+  ~ScopedCairoTarget() {
+    cairo_surface_flush(cairo_get_target(CairoInst()));
+    cairo_destroy(CairoInst());
+    CairoInst() = m_saved;
+  }
+
+private:
+  CairoPtr m_saved;
+};
+
+/// milliseconds since the first call.
+double GetTimeMS();
+
+/// Little container class for a data property from the page config file.
+/// Total overkill :)
+template<typename T> class QuanTermProp {
+public:
+  struct ValueArrayElement {
+    std::string m_name;
+    T *m_pValue;
+  };
+  typedef std::vector<ValueArrayElement> ValueArray;
+  
+  QuanTermProp(const std::string& name, T *pValue, T initValue)
+  {
+    *pValue = initValue;
+    CreateProp(name, pValue);
+  }
+
+  static ValueArray& GetArray() {
+    static ValueArray arr;
+    return arr;
+  }
+
+  static ValueArrayElement *FindElement(const std::string& name) {
+    ValueArray &arr = GetArray();
+    for(size_t n = 0; n<arr.size(); ++n) {
+      if(arr[n].m_name == name)
+	return &arr[n];
+    }
+    return nullptr;
+  }
+  
+  static void CreateProp(const std::string& name, T *pValue) {
+    ValueArrayElement *elem = FindElement(name);
+    if(elem == nullptr) {
+      GetArray().push_back({name, pValue});
+      return;
+    }
+    elem->m_pValue = pValue;
+    return;
+  }
+  
+  static bool UpdateProp(const std::string& name, T value) {
+    ValueArrayElement *elem = FindElement(name);
+    if(!elem)
+      return false;
+    *(elem->m_pValue) = value;
+    return true;
+  }
+};
+
+
+/// A vector of 3 floats making an  rgb colour
+struct QRGB {
+  QRGB() : r(1.0), g(1.0), b(1.0) { }  
+  QRGB(float r_, float g_, float b_) : r(r_), g(g_), b(b_) { }
+  float r, g, b;
+};
+
+#define DEF_Q_DOUBLE(name, initValue) double name; QuanTermProp<double> m_##name = QuanTermProp<double>( #name, &name, (double)initValue)
+#define DEF_Q_COLOUR(name, initValue) QRGB name; QuanTermProp<QRGB> m_##name = QuanTermProp<QRGB>( #name, &name, initValue)
+#define DEF_Q_STRING(name, initValue) std::string name; QuanTermProp<std::string> m_##name = QuanTermProp<std::string>( #name, &name, initValue)
+
+/// The configuration for the page rendering, sizes and colours etc
+class QuanTermPageConfig {
+public:
+  DEF_Q_DOUBLE(FontSizeNormal, 14);
+  DEF_Q_DOUBLE(FontSizeHeading, 18);
+  DEF_Q_DOUBLE(CharHeight, 18);
+  DEF_Q_DOUBLE(CharWidth, 5);
+  DEF_Q_DOUBLE(MarginX, 100);
+  DEF_Q_DOUBLE(MarginY, 20);
+  DEF_Q_DOUBLE(ButtonHeight, 18 + 3);
+  DEF_Q_DOUBLE(ButtonBorder, 3);
+  DEF_Q_DOUBLE(ScrollSpeed, 5);
+  DEF_Q_DOUBLE(VideoPosY, 40);
+  /// 1 has libvlc decode to planar YUV which is converted and scaled in one pass, rather than RGB565.
+  DEF_Q_DOUBLE(VideoYUV, 0);
+  DEF_Q_DOUBLE(IdleTimeoutSeconds, 15); 
+  /// after the attractor has run this long it drops to AttractorLowFPS, and after BlankSeconds the
+  /// display is powered down until a button is pressed. Zero turns either off.
+  DEF_Q_DOUBLE(AttractorLowFPSSeconds, 300);
+  DEF_Q_DOUBLE(AttractorLowFPS, 5);
+  DEF_Q_DOUBLE(BlankSeconds, 1800);
+  /// the cores, as a bitmask, for the main loop which renders and reads the buttons, the present
+  /// workers and libvlc's video output thread. Zero leaves them to the kernel.
+  DEF_Q_DOUBLE(RenderCPUMask, 0);
+  DEF_Q_DOUBLE(WorkerCPUMask, 0);
+  DEF_Q_DOUBLE(VideoCPUMask, 0);
+  /// 1 for SCHED_FIFO or 2 for SCHED_RR at RealtimePriority for all of them, 0 leaves them time shared.
+  DEF_Q_DOUBLE(RealtimePolicy, 0);
+  DEF_Q_DOUBLE(RealtimePriority, 10);
+  /// 1 locks the back buffer and video buffers into RAM.
+  DEF_Q_DOUBLE(LockBuffers, 0);
+  DEF_Q_DOUBLE(PageScrollStep, 200);
+  DEF_Q_DOUBLE(PageScrollSpeed, 20);
+  DEF_Q_DOUBLE(PrerenderPages, 4);
+  DEF_Q_DOUBLE(PageTransition, 0);
+  DEF_Q_DOUBLE(PageTransitionFrames, 8);
+  /// how many pages 'back' can return to, and the memory their compressed screens may take.
+  DEF_Q_DOUBLE(BackPages, 8);
+  DEF_Q_DOUBLE(BackMemoryKB, 4096);
+  /// comma separated videos under the pages root which loop instead of the logo when idle.
+  DEF_Q_STRING(AttractorPlaylist, "");
+  
+  DEF_Q_COLOUR(TextColour, QRGB(0.0f, 1.0f, 0.0f));
+  DEF_Q_COLOUR(TextBackgroundColour, QRGB(0.0f, 0.0f, 0.0f));
+  DEF_Q_COLOUR(ImageBorderColour, QRGB(0.0, 0.4, 0.0));
+  DEF_Q_COLOUR(ButtonColour, QRGB(0.0, 1.0, 1.0));
+  
+  bool LoadPageConfig(const char *filename);
+
+};
+
+class QuanTermApp {
+  /// the benchmark drives the rendering functions directly.
+  friend class QuanTermBench;
+  
+protected:
+  /// Renders mulitple lines split by newlines
+  void ShowTextMultiline(std::string_view txt, const int xorigin, const int yorigin);
+  /// calculates the size of mulitple lines split by newlines.
+  void SizeTextMultiline(std::string_view txt, int& width, int& height);
+  /// Prints text with automatic wrapping ingnoring any existing newlines.  Returns new y position.
+  /// Only the first 'shownLen' characters are drawn, the rest are still laid out so a word being
+  /// revealed wraps where it will once it is complete.
+  int ShowWrappedText(std::string_view txt, size_t shownLen, const int x, int y, const int maxWidth);
+  /// reads a specially crafted file contain a page.
+  bool ReadPageData(const std::string& filename, PageDocument& page, std::vector<ButtonData>& buttons);
+  /// loads an image from the bundle if there is one, otherwise decodes the png at 'path'.
+  cairo_surface_t *LoadImageSurface(const std::string& name, const std::string& path);
+  /// Renders the attractor screen which is shown when the unit is idle and waiting for a user.
+  void RenderAttractorScreen();
+  /// blanks the display and stops everything until there is input, then puts the last frame back up.
+  void SleepDisplay();
+  /// loops the comma separated videos in 'list', from the pages root.
+  bool PlayVideoList(std::string_view list);
+  /// starts decoding the logo, reading the index page and warming the font cache on other threads.
+  void StartBackgroundLoads();
+  /// the placement for a thread from the page config's real time settings and 'cpuMask'.
+  ThreadPlacement GetThreadPlacement(double cpuMask) const;
+  /// pins the main loop, workers and video thread and locks the buffers as the page config says.
+  void ApplyThreadSettings();
+  /// draws every printable character in each of the page fonts off screen so the glyphs are cached.
+  void WarmFontCache();
+  
+private:
+  /// internal to RenderPageContent - renders the current text at the current location and current formatting,
+  /// leaving off the last 'hiddenLen' characters which the reveal hasn't reached yet.
+  void RenderText(std::string_view curText, size_t hiddenLen = 0);
+  /// internal to RenderPageContent - renders the current image at the current location and current formatting  
+  void RenderImage(std::string_view curText);
+  
+protected:
+  /// renders the page text that was loaded from ReadPageData
+  void RenderPageContent(const PageDocument& page, int howMuch);
+  /// a rendered button and the margin cell around it.
+  struct ButtonStrip {
+    std::string m_caption;
+    std::vector<uint32_t> m_pixels;
+  };
+  /// render the side buttons. Buttons drawn anywhere but the screen, such as a prerendered page,
+  /// pass 'keepStrips' false so they don't replace the strips kept for the screen's buttons.
+  void RenderSideButtons(const std::vector<ButtonData>& buttons, bool keepStrips = true);
+  /// draws a button into 'strip' for RenderSideButtons to copy into place.
+  void RenderButtonStrip(ButtonStrip& strip, const ButtonData& btnData);
+  /// copies tightly packed pixels into whatever CairoInst is currently drawing to.
+  void BlitToCairoTarget(const uint32_t *pixels, int width, int height, int x, int y);
+  /// Loads a new page replacing m_pageData and m_buttons, returns false if it couldn't be read.
+  bool LoadNewPage(const std::string& filename);
+  /// loads a page from a button, keeping the one on screen for GoBack.
+  void NavigateTo(const std::string& filename);
+  /// puts the page before the last NavigateTo back on screen.
+  bool GoBack();
+  void ClearBackStack();
+  /// the page a button's command goes to, either a .txt file or navigate:page, or empty.
+  static std::string_view GetPageLink(std::string_view cmd);
+  /// renders the currently loaded pages at its current progress level.
+  void RenderCurrentPage();
+  /// the full height column the page text and images go in, with a little extra for the image borders.
+  FBRect GetContentColumn() const;
+  /// responds to a button press.
+  void HandleButtonPress(int n, const std::vector<ButtonData>& buttons);
+  /// renders the whole of a page that is too long for the screen into m_scrollSurface.
+  void CreateScrollSurface(int pageHeight);
+  void DestroyScrollSurface();
+  /// copies the visible part of the scroll surface to the screen.
+  void RenderScrollView();
+  /// moves the view one frame's worth towards m_scrollTarget.
+  void StepScroll();
+  /// renders one of the pages the current page links to into a spare buffer, returns false when there is nothing to do.
+  bool PrerenderNextPage();
+  /// shows a prerendered page in one copy, or with the configured transition.
+  void ShowPrerenderedPage(const uint32_t *pixels);
+  
+public:
+  int AppMain();
+
+  void SetPagesRoot(const char *dir) {
+    m_pagesRoot = dir;
+  }
+
+  /// use a bundle made by quanterm-pack in preference to the files in the pages root.
+  bool OpenBundle(const char *filename) {
+    return m_bundle.Open(filename);
+  }
+
+private:
+  PageDocument m_pageData;
+  std::vector<ButtonData> m_buttons;
+  int m_pageProgress = 0;
+  int m_pageLen = 0;
+
+  int m_xpos = 0;
+  int m_ypos = 0;
+  bool m_bold = false;
+  bool m_heading = false;
+  bool m_image = false;
+  enum {PREFORMAT_OFF, PREFORMAT_STORE, PREFORMAT_OUTPUT};
+  int m_preformat = PREFORMAT_OFF;
+
+  /// scratch memory for the current frame, reset at the top of every main loop iteration.
+  FrameArena m_frameArena;
+  /// bumped whenever something is loaded, frames which load things aren't expected to be allocation free.
+  int m_loadEpoch = 0;
+
+  /// a long page is rendered once into this tall surface which holds the content column,
+  /// and the screen shows the rows from m_scrollY.
+  cairo_surface_t *m_scrollSurface = nullptr;
+  int m_scrollX = 0;
+  int m_scrollY = 0;
+  int m_scrollTarget = 0;
+
+  /// a page fully rendered off screen, buttons and all, ready to be shown without any rendering.
+  struct PrerenderedPage {
+    std::string m_name;
+    PageDocument m_page;
+    std::vector<ButtonData> m_buttons;
+    std::vector<uint32_t> m_pixels;
+    int m_contentHeight = 0;
+  };
+  /// least recently used first.
+  std::vector<std::unique_ptr<PrerenderedPage>> m_prerendered;
+
+  /// a page navigated away from, with its screen run length encoded so going back to it needs no
+  /// parsing or rendering. A page left before it was fully revealed has no screen and is loaded again.
+  struct BackPage {
+    std::string m_name;
+    PageDocument m_page;
+    std::vector<ButtonData> m_buttons;
+    std::vector<uint32_t> m_runs;
+    /// the height of the scroll surface for a long page, and where it was scrolled to.
+    int m_scrollHeight = 0;
+    int m_scrollY = 0;
+  };
+  /// oldest first.
+  std::vector<std::unique_ptr<BackPage>> m_backStack;
+  size_t m_backStackBytes = 0;
+  /// the name of the page on screen.
+  std::string m_pageName;
+  enum {TRANSITION_NONE, TRANSITION_WIPE, TRANSITION_SLIDE};
+
+  static constexpr int ButtonSlots = 8;
+  ButtonStrip m_buttonStrips[ButtonSlots];
+  /// where buttons which aren't kept are drawn.
+  ButtonStrip m_scratchStrip;
+  /// how many strips have been drawn, for the bench to check a page with the same captions draws none.
+  unsigned m_stripRenders = 0;
+
+  QuanTermPageConfig m_pageCfg;
+
+  bool m_wantVideoStop = false;
+
+  /// startup work from StartBackgroundLoads, collected the first time it is needed.
+  std::future<cairo_surface_t *> m_logoLoad;
+  cairo_surface_t *m_logoImg = nullptr;
+  std::future<bool> m_indexLoad;
+  PageDocument m_indexPage;
+  std::vector<ButtonData> m_indexButtons;
+  std::future<void> m_fontWarmUp;
+
+  std::string m_pagesRoot = "./";
+  PageBundle m_bundle;
+};
@@ -0,0 +1,405 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <string.h>
+
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define QT_COMPOSITE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define QT_COMPOSITE_SSE2
+#endif
+
+#include "span-composite.h"
+
+// Every kernel is the same loop: fetch a premultiplied source pixel, optionally scale it by a
+// mask value, then blend it over the destination. The SIMD versions do a block of pixels at a
+// time and leave the remainder to the scalar loop, and all of them round identically.
+
+/// x / 255 rounded, for x up to 255 * 255.
+static inline uint32_t Div255(uint32_t x)
+{
+  x += 128;
+  return (x + (x >> 8)) >> 8;
+}
+
+/// multiplies all four channels of 'p' by m / 255.
+static inline uint32_t ScalePixel(uint32_t p, uint32_t m)
+{
+  uint32_t rb = (p & 0x00ff00ff) * m + 0x00800080;
+  rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+  uint32_t ag = ((p >> 8) & 0x00ff00ff) * m + 0x00800080;
+  ag = (ag + ((ag >> 8) & 0x00ff00ff)) & 0xff00ff00;
+  return rb | ag;
+}
+
+static inline uint32_t OverPixel(uint32_t dst, uint32_t src)
+{
+  return src + ScalePixel(dst, 255 - (src >> 24));
+}
+
+static inline uint32_t Expand565(uint16_t p)
+{
+  const uint32_t r = p >> 11;
+  const uint32_t g = (p >> 5) & 63;
+  const uint32_t b = p & 31;
+  return 0xff000000 | (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+}
+
+static inline uint16_t Pack565(uint32_t p)
+{
+  return ((p >> 8) & 0xf800) | ((p >> 5) & 0x07e0) | ((p >> 3) & 0x001f);
+}
+
+static inline void BlendPixel(uint32_t& dst, uint32_t src)
+{
+  dst = OverPixel(dst, src);
+}
+
+static inline void BlendPixel(uint16_t& dst, uint32_t src)
+{
+  dst = Pack565(OverPixel(Expand565(dst), src));
+}
+
+#if defined(QT_COMPOSITE_SSE2)
+
+static inline __m128i Div255x16(__m128i x)
+{
+  x = _mm_add_epi16(x, _mm_set1_epi16(128));
+  return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+/// scales four pixels by the 16bit lanes of 'mLo' for the first two and 'mHi' for the second two.
+static inline __m128i Scale4(__m128i s, __m128i mLo, __m128i mHi)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i lo = Div255x16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), mLo));
+  const __m128i hi = Div255x16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), mHi));
+  return _mm_packus_epi16(lo, hi);
+}
+
+static inline __m128i Over4(__m128i d, __m128i s)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ff = _mm_set1_epi16(255);
+  const __m128i sLo = _mm_unpacklo_epi8(s, zero);
+  const __m128i sHi = _mm_unpackhi_epi8(s, zero);
+  const __m128i iaLo = _mm_sub_epi16(ff, _mm_shufflehi_epi16(_mm_shufflelo_epi16(sLo, 0xff), 0xff));
+  const __m128i iaHi = _mm_sub_epi16(ff, _mm_shufflehi_epi16(_mm_shufflelo_epi16(sHi, 0xff), 0xff));
+  const __m128i dLo = Div255x16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), iaLo));
+  const __m128i dHi = Div255x16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), iaHi));
+  return _mm_add_epi8(s, _mm_packus_epi16(dLo, dHi));
+}
+
+/// one channel of four pixels from each of 'a' and 'b' as eight 16bit lanes.
+static inline __m128i Channel8(__m128i a, __m128i b, int shift)
+{
+  const __m128i ff = _mm_set1_epi32(255);
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  return _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(a, count), ff), _mm_and_si128(_mm_srl_epi32(b, count), ff));
+}
+
+#elif defined(QT_COMPOSITE_NEON)
+
+static inline uint8x8_t Div255x8(uint16x8_t x)
+{
+  return vraddhn_u16(x, vrshrq_n_u16(x, 8));
+}
+
+/// src planes over dst planes, both b, g, r, a.
+static inline uint8x8x4_t Over8(uint8x8x4_t d, uint8x8x4_t s)
+{
+  const uint8x8_t ia = vmvn_u8(s.val[3]);
+  for(int c = 0; c<4; c++)
+    d.val[c] = vadd_u8(s.val[c], Div255x8(vmull_u8(d.val[c], ia)));
+  return d;
+}
+
+#endif
+
+/// the source pixels come from a row.
+struct SpanSource {
+  explicit SpanSource(const uint32_t *pixels) : m_pixels(pixels) { }
+  uint32_t Get(int i) const { return m_pixels[i]; }
+#if defined(QT_COMPOSITE_SSE2)
+  __m128i Load4(int i) const { return _mm_loadu_si128((const __m128i *)(m_pixels + i)); }
+#elif defined(QT_COMPOSITE_NEON)
+  uint8x8x4_t Load8(int i) const { return vld4_u8((const uint8_t *)(m_pixels + i)); }
+#endif
+  const uint32_t *m_pixels;
+};
+
+/// every source pixel is the same colour.
+struct SolidSource {
+  explicit SolidSource(uint32_t color) : m_color(color) {
+#if defined(QT_COMPOSITE_SSE2)
+    m_color4 = _mm_set1_epi32(color);
+#elif defined(QT_COMPOSITE_NEON)
+    for(int c = 0; c<4; c++)
+      m_planes.val[c] = vdup_n_u8((color >> (c * 8)) & 0xff);
+#endif
+  }
+  uint32_t Get(int) const { return m_color; }
+#if defined(QT_COMPOSITE_SSE2)
+  __m128i Load4(int) const { return m_color4; }
+  __m128i m_color4;
+#elif defined(QT_COMPOSITE_NEON)
+  uint8x8x4_t Load8(int) const { return m_planes; }
+  uint8x8x4_t m_planes;
+#endif
+  uint32_t m_color;
+};
+
+struct NoMask {
+  static constexpr bool Active = false;
+  uint32_t Get(int) const { return 255; }
+};
+
+/// the same alpha for every pixel.
+struct ConstMask {
+  static constexpr bool Active = true;
+  explicit ConstMask(int alpha) : m_alpha(alpha) {
+#if defined(QT_COMPOSITE_SSE2)
+    m_lanes = _mm_set1_epi16(alpha);
+#endif
+  }
+  uint32_t Get(int) const { return m_alpha; }
+#if defined(QT_COMPOSITE_SSE2)
+  bool Skip4(int) const { return false; }
+  void Lanes4(int, __m128i& lo, __m128i& hi) const { lo = hi = m_lanes; }
+  __m128i m_lanes;
+#elif defined(QT_COMPOSITE_NEON)
+  uint8x8_t Load8(int) const { return vdup_n_u8(m_alpha); }
+#endif
+  uint32_t m_alpha;
+};
+
+/// a coverage value per pixel.
+struct SpanMask {
+  static constexpr bool Active = true;
+  explicit SpanMask(const uint8_t *mask) : m_mask(mask) { }
+  uint32_t Get(int i) const { return m_mask[i]; }
+#if defined(QT_COMPOSITE_SSE2)
+  bool Skip4(int i) const {
+    uint32_t m;
+    memcpy(&m, m_mask + i, 4);
+    return m == 0;
+  }
+  void Lanes4(int i, __m128i& lo, __m128i& hi) const {
+    int32_t m;
+    memcpy(&m, m_mask + i, 4);
+    // each coverage byte repeated for all four channels of its pixel.
+    __m128i v = _mm_cvtsi32_si128(m);
+    v = _mm_unpacklo_epi8(v, v);
+    v = _mm_unpacklo_epi16(v, v);
+    lo = _mm_unpacklo_epi8(v, _mm_setzero_si128());
+    hi = _mm_unpackhi_epi8(v, _mm_setzero_si128());
+  }
+#elif defined(QT_COMPOSITE_NEON)
+  uint8x8_t Load8(int i) const { return vld1_u8(m_mask + i); }
+#endif
+  const uint8_t *m_mask;
+};
+
+template<typename Source, typename Mask>
+static void CompositeSpan(uint32_t *dst, int count, const Source& src, const Mask& mask)
+{
+  int i = 0;
+#if defined(QT_COMPOSITE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i alphaBits = _mm_set1_epi32(0xff000000);
+  for(; i + 4 <= count; i += 4) {
+    __m128i s = src.Load4(i);
+    if constexpr(Mask::Active) {
+      if(mask.Skip4(i))
+	continue;
+      __m128i lo, hi;
+      mask.Lanes4(i, lo, hi);
+      s = Scale4(s, lo, hi);
+    }
+    // runs of fully opaque or fully transparent pixels are common in sprites and need no blending.
+    if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphaBits), alphaBits)) == 0xffff) {
+      _mm_storeu_si128((__m128i *)(dst + i), s);
+      continue;
+    }
+    if(_mm_movemask_epi8(_mm_cmpeq_epi32(s, zero)) == 0xffff)
+      continue;
+    _mm_storeu_si128((__m128i *)(dst + i), Over4(_mm_loadu_si128((const __m128i *)(dst + i)), s));
+  }
+#elif defined(QT_COMPOSITE_NEON)
+  for(; i + 8 <= count; i += 8) {
+    uint8x8x4_t s = src.Load8(i);
+    if constexpr(Mask::Active) {
+      const uint8x8_t m = mask.Load8(i);
+      for(int c = 0; c<4; c++)
+	s.val[c] = Div255x8(vmull_u8(s.val[c], m));
+    }
+    uint8_t *d = (uint8_t *)(dst + i);
+    vst4_u8(d, Over8(vld4_u8(d), s));
+  }
+#endif
+  for(; i<count; i++) {
+    uint32_t s = src.Get(i);
+    if constexpr(Mask::Active)
+      s = ScalePixel(s, mask.Get(i));
+    if(s)
+      BlendPixel(dst[i], s);
+  }
+}
+
+template<typename Source, typename Mask>
+static void CompositeSpan(uint16_t *dst, int count, const Source& src, const Mask& mask)
+{
+  int i = 0;
+#if defined(QT_COMPOSITE_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ff = _mm_set1_epi16(255);
+  for(; i + 8 <= count; i += 8) {
+    __m128i s0 = src.Load4(i);
+    __m128i s1 = src.Load4(i + 4);
+    if constexpr(Mask::Active) {
+      __m128i lo, hi;
+      mask.Lanes4(i, lo, hi);
+      s0 = Scale4(s0, lo, hi);
+      mask.Lanes4(i + 4, lo, hi);
+      s1 = Scale4(s1, lo, hi);
+    }
+    if(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi32(s0, zero), _mm_cmpeq_epi32(s1, zero))) == 0xffff)
+      continue;
+
+    // planar 16bit lanes for eight pixels of source and destination.
+    const __m128i sb = Channel8(s0, s1, 0);
+    const __m128i sg = Channel8(s0, s1, 8);
+    const __m128i sr = Channel8(s0, s1, 16);
+    const __m128i ia = _mm_sub_epi16(ff, Channel8(s0, s1, 24));
+
+    const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+    const __m128i r5 = _mm_srli_epi16(d, 11);
+    const __m128i g6 = _mm_and_si128(_mm_srli_epi16(d, 5), _mm_set1_epi16(63));
+    const __m128i b5 = _mm_and_si128(d, _mm_set1_epi16(31));
+    const __m128i r8 = _mm_or_si128(_mm_slli_epi16(r5, 3), _mm_srli_epi16(r5, 2));
+    const __m128i g8 = _mm_or_si128(_mm_slli_epi16(g6, 2), _mm_srli_epi16(g6, 4));
+    const __m128i b8 = _mm_or_si128(_mm_slli_epi16(b5, 3), _mm_srli_epi16(b5, 2));
+
+    const __m128i r = _mm_add_epi16(sr, Div255x16(_mm_mullo_epi16(r8, ia)));
+    const __m128i g = _mm_add_epi16(sg, Div255x16(_mm_mullo_epi16(g8, ia)));
+    const __m128i b = _mm_add_epi16(sb, Div255x16(_mm_mullo_epi16(b8, ia)));
+    const __m128i out = _mm_or_si128(_mm_or_si128(_mm_slli_epi16(_mm_srli_epi16(r, 3), 11),
+						  _mm_slli_epi16(_mm_srli_epi16(g, 2), 5)),
+				     _mm_srli_epi16(b, 3));
+    _mm_storeu_si128((__m128i *)(dst + i), out);
+  }
+#elif defined(QT_COMPOSITE_NEON)
+  for(; i + 8 <= count; i += 8) {
+    uint8x8x4_t s = src.Load8(i);
+    if constexpr(Mask::Active) {
+      const uint8x8_t m = mask.Load8(i);
+      for(int c = 0; c<4; c++)
+	s.val[c] = Div255x8(vmull_u8(s.val[c], m));
+    }
+
+    const uint16x8_t d = vld1q_u16(dst + i);
+    const uint16x8_t g6 = vandq_u16(vshrq_n_u16(d, 5), vdupq_n_u16(63));
+    const uint16x8_t b5 = vandq_u16(d, vdupq_n_u16(31));
+    uint8x8x4_t planes;
+    planes.val[0] = vmovn_u16(vorrq_u16(vshlq_n_u16(b5, 3), vshrq_n_u16(b5, 2)));
+    planes.val[1] = vmovn_u16(vorrq_u16(vshlq_n_u16(g6, 2), vshrq_n_u16(g6, 4)));
+    planes.val[2] = vmovn_u16(vorrq_u16(vshlq_n_u16(vshrq_n_u16(d, 11), 3), vshrq_n_u16(d, 13)));
+    planes.val[3] = vdup_n_u8(255);
+    planes = Over8(planes, s);
+
+    const uint16x8_t r = vshlq_n_u16(vshrq_n_u16(vmovl_u8(planes.val[2]), 3), 11);
+    const uint16x8_t g = vshlq_n_u16(vshrq_n_u16(vmovl_u8(planes.val[1]), 2), 5);
+    const uint16x8_t b = vshrq_n_u16(vmovl_u8(planes.val[0]), 3);
+    vst1q_u16(dst + i, vorrq_u16(vorrq_u16(r, g), b));
+  }
+#endif
+  for(; i<count; i++) {
+    uint32_t s = src.Get(i);
+    if constexpr(Mask::Active)
+      s = ScalePixel(s, mask.Get(i));
+    if(s)
+      BlendPixel(dst[i], s);
+  }
+}
+
+void CompositeSpanOver(uint32_t *dst, const uint32_t *src, int count)
+{
+  CompositeSpan(dst, count, SpanSource(src), NoMask());
+}
+
+void CompositeSpanOver(uint16_t *dst, const uint32_t *src, int count)
+{
+  CompositeSpan(dst, count, SpanSource(src), NoMask());
+}
+
+void CompositeSpanOverAlpha(uint32_t *dst, const uint32_t *src, int count, int alpha)
+{
+  if(alpha >= 255)
+    CompositeSpan(dst, count, SpanSource(src), NoMask());
+  else if(alpha > 0)
+    CompositeSpan(dst, count, SpanSource(src), ConstMask(alpha));
+}
+
+void CompositeSpanOverAlpha(uint16_t *dst, const uint32_t *src, int count, int alpha)
+{
+  if(alpha >= 255)
+    CompositeSpan(dst, count, SpanSource(src), NoMask());
+  else if(alpha > 0)
+    CompositeSpan(dst, count, SpanSource(src), ConstMask(alpha));
+}
+
+void CompositeSpanFill(uint32_t *dst, int count, uint32_t color)
+{
+  if((color >> 24) == 255)
+    std::fill(dst, dst + count, color);
+  else if(color)
+    CompositeSpan(dst, count, SolidSource(color), NoMask());
+}
+
+void CompositeSpanFill(uint16_t *dst, int count, uint32_t color)
+{
+  if((color >> 24) == 255)
+    std::fill(dst, dst + count, Pack565(color));
+  else if(color)
+    CompositeSpan(dst, count, SolidSource(color), NoMask());
+}
+
+void CompositeSpanMask(uint32_t *dst, const uint8_t *mask, int count, uint32_t color)
+{
+  if(color)
+    CompositeSpan(dst, count, SolidSource(color), SpanMask(mask));
+}
+
+void CompositeSpanMask(uint16_t *dst, const uint8_t *mask, int count, uint32_t color)
+{
+  if(color)
+    CompositeSpan(dst, count, SolidSource(color), SpanMask(mask));
+}
+
+uint32_t PremultiplyColor(uint32_t color)
+{
+  const uint32_t alpha = color >> 24;
+  return (ScalePixel(color, alpha) & 0x00ffffff) | (alpha << 24);
+}
+
+const char *CompositeKernelName()
+{
+#if defined(QT_COMPOSITE_SSE2)
+  return "sse2";
+#elif defined(QT_COMPOSITE_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
@@ -0,0 +1,33 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+// Span kernels for compositing onto a row of pixels with the OVER operator. Sources and colours are
+// premultiplied ARGB32, the same as cairo's image surfaces, and the destination is ARGB32 or RGB565.
+// They are SSE2 or NEON when the compiler targets them, plain C++ otherwise.
+
+/// src over dst.
+void CompositeSpanOver(uint32_t *dst, const uint32_t *src, int count);
+void CompositeSpanOver(uint16_t *dst, const uint32_t *src, int count);
+/// src faded by a constant 'alpha' (0-255) over dst.
+void CompositeSpanOverAlpha(uint32_t *dst, const uint32_t *src, int count, int alpha);
+void CompositeSpanOverAlpha(uint16_t *dst, const uint32_t *src, int count, int alpha);
+/// a solid colour over dst.
+void CompositeSpanFill(uint32_t *dst, int count, uint32_t color);
+void CompositeSpanFill(uint16_t *dst, int count, uint32_t color);
+/// a solid colour through a row of 8bit coverage values over dst, for glyphs and other masks.
+void CompositeSpanMask(uint32_t *dst, const uint8_t *mask, int count, uint32_t color);
+void CompositeSpanMask(uint16_t *dst, const uint8_t *mask, int count, uint32_t color);
+
+/// premultiplies a straight alpha 0xAARRGGBB colour.
+uint32_t PremultiplyColor(uint32_t color);
+
+/// "sse2", "neon" or "scalar", whichever the kernels were built with.
+const char *CompositeKernelName();
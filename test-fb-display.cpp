@@ -0,0 +1,141 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+
+#include "thread-tuning.h"
+#include "video-pacer.h"
+#include "fb-display.h"
+#include "pixel-format.h"
+
+namespace {
+const char *FrameFile = "test-fb-display.tmp";
+constexpr int ScreenWidth = 16;
+constexpr int ScreenHeight = 12;
+
+/// an I420 frame where every luma and chroma sample is different, so a pixel taken from the wrong
+/// place shows up.
+struct YUVFrame {
+  int m_width;
+  int m_height;
+  std::vector<uint8_t> m_planes;
+
+  YUVFrame(int width, int height) : m_width(width), m_height(height) {
+    const int chromaSize = (width / 2) * (height / 2);
+    m_planes.resize(width * height + chromaSize * 2);
+    for(int n = 0; n < width * height; n++)
+      m_planes[n] = uint8_t(16 + (n * 7) % 220);
+    for(int n = 0; n < chromaSize; n++) {
+      m_planes[width * height + n] = uint8_t(40 + (n * 11) % 180);
+      m_planes[width * height + chromaSize + n] = uint8_t(200 - (n * 13) % 180);
+    }
+  }
+
+  /// what the source pixel x, y converts to, through the same kernel as the blit.
+  uint32_t Expected(const PixelKernels& kernels, int x, int y) const {
+    const int chromaWidth = m_width / 2;
+    const int chroma = std::min(y / 2, m_height / 2 - 1) * chromaWidth + std::min(x / 2, chromaWidth - 1);
+    const uint8_t *u = &m_planes[m_width * m_height];
+    const uint8_t *v = u + chromaWidth * (m_height / 2);
+    uint32_t out[4];
+    kernels.m_fromYUVDouble(out, 8, &m_planes[y * m_width + x], u + chroma, v + chroma, 1);
+    return out[0];
+  }
+};
+
+/// the screen columns, or rows, a doubled frame 'size' long at 'pos' fills. Source pixels only half
+/// on the screen are left out, so an odd overhang leaves a column of the clear colour at the edge.
+void DoubledSpan(int pos, int size, int screen, int& first, int& end)
+{
+  const int skip = pos < 0 ? (1 - pos) / 2 : 0;
+  first = pos + skip * 2;
+  end = first + std::min(size - skip, (screen - first) / 2) * 2;
+}
+
+/// blits 'frame' centred on the screen like vlcDisplay does and checks every screen pixel the
+/// doubled frame fills holds the source pixel beneath it, and the rest are still clear.
+bool BlitCentred(const char *name, const YUVFrame& frame)
+{
+  // a fresh file each time, so nothing is left from the last frame.
+  unlink(FrameFile);
+  FBDisplayConfig config;
+  config.m_backend = FBDisplayConfig::FILE;
+  config.m_path = FrameFile;
+  config.m_width = ScreenWidth;
+  config.m_height = ScreenHeight;
+  config.m_threads = 1;
+  FBDisplay display;
+  display.SetConfig(config);
+  if(!display.Open()) {
+    printf("%s: WRONG, can't open the display\n", name);
+    return false;
+  }
+
+  const int xpos = (ScreenWidth - frame.m_width * 2) / 2;
+  const int ypos = (ScreenHeight - frame.m_height * 2) / 2;
+  display.BlitYUVDoubleScale(frame.m_planes.data(), frame.m_width, frame.m_height, xpos, ypos);
+  display.Close();
+
+  // the file backend keeps the front buffer where it can be read back.
+  std::ifstream file(FrameFile, std::ios::binary);
+  const std::vector<char> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if(bytes.size() != size_t(ScreenWidth * ScreenHeight * 4)) {
+    printf("%s: WRONG, the front buffer is %zu bytes\n", name, bytes.size());
+    return false;
+  }
+
+  int firstX, endX, firstY, endY;
+  DoubledSpan(xpos, frame.m_width, ScreenWidth, firstX, endX);
+  DoubledSpan(ypos, frame.m_height, ScreenHeight, firstY, endY);
+  const PixelKernels& kernels = *FindPixelKernels(32, 16, false);
+  int covered = 0;
+  int wrong = 0;
+  for(int y = 0; y < ScreenHeight; y++) {
+    for(int x = 0; x < ScreenWidth; x++) {
+      uint32_t pixel;
+      memcpy(&pixel, &bytes[(y * ScreenWidth + x) * 4], 4);
+      const bool inside = (x >= firstX && x < endX && y >= firstY && y < endY);
+      const uint32_t expected = inside ? frame.Expected(kernels, (x - xpos) / 2, (y - ypos) / 2) : 0;
+      covered += inside;
+      if(pixel != expected && wrong++ < 4)
+	printf("%s: pixel %d, %d is %08x not %08x\n", name, x, y, pixel, expected);
+    }
+  }
+  printf("%s: %d pixels covered, %d wrong: %s\n", name, covered, wrong, (covered && !wrong) ? "ok" : "WRONG");
+  return covered && !wrong;
+}
+}
+
+int main()
+{
+  // the screen is 16x12, doubled these fit, or spill over by enough to skip odd and even numbers
+  // of source columns and rows.
+  bool ok = BlitCentred("fits", YUVFrame(6, 4));
+  ok = BlitCentred("odd size fits", YUVFrame(7, 5)) && ok;
+  ok = BlitCentred("even skip", YUVFrame(12, 10)) && ok;
+  ok = BlitCentred("odd skip", YUVFrame(10, 8)) && ok;
+  ok = BlitCentred("odd skip odd size", YUVFrame(9, 7)) && ok;
+  ok = BlitCentred("odd skip, three columns", YUVFrame(13, 9)) && ok;
+  ok = BlitCentred("much larger", YUVFrame(41, 33)) && ok;
+  unlink(FrameFile);
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <iterator>
+#include <functional>
+
+#include "page-data.h"
+#include "page-bundle.h"
+
+using namespace PageBundleFormat;
+
+namespace {
+const char *BundleFile = "test-page-bundle.tmp";
+
+std::vector<char> WriteGoodBundle()
+{
+  PageBundleWriter writer;
+  writer.AddPage("index.txt", "=Welcome=\nHello _there_ [logo.png]\n", {{"Back", "index.txt"}, {"Video", "a.mp4"}});
+  writer.AddPage("other.txt", "Some more text\n", {{"Home", "index.txt"}});
+  const std::vector<unsigned char> pixels(4 * 4 * 4, 0xff);
+  writer.AddImage("logo.png", &pixels[0], 4, 4, 16);
+  if(!writer.Write(BundleFile))
+    return {};
+  std::ifstream file(BundleFile, std::ios::binary);
+  return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+/// writes 'bytes' out after 'corrupt' has changed them and says whether the bundle still opens.
+bool Opens(std::vector<char> bytes, const std::function<void(std::vector<char>&, const Header&)>& corrupt)
+{
+  Header header;
+  memcpy(&header, &bytes[0], sizeof(header));
+  corrupt(bytes, header);
+  FILE *file = fopen(BundleFile, "wb");
+  if(!file)
+    return false;
+  fwrite(&bytes[0], 1, bytes.size(), file);
+  fclose(file);
+  PageBundle bundle;
+  return bundle.Open(BundleFile);
+}
+
+template<typename T> T *At(std::vector<char>& bytes, uint32_t offset)
+{
+  return (T *)&bytes[offset];
+}
+}
+
+int main()
+{
+  const std::vector<char> good = WriteGoodBundle();
+  if(good.empty()) {
+    printf("FAIL: couldn't write the bundle\n");
+    return 1;
+  }
+
+  int failures = 0;
+  auto Expect = [&](const char *what, bool opens, bool wanted) {
+    printf("%s: %s\n", what, opens == wanted ? "ok" : "WRONG");
+    failures += opens != wanted;
+  };
+
+  {
+    PageBundle bundle;
+    const bool opened = bundle.Open(BundleFile);
+    const Page *page = opened ? bundle.FindPage("other.txt") : nullptr;
+    Expect("intact bundle", page && strcmp(bundle.GetPageContent(page), "Some more text\n") == 0 &&
+	   bundle.FindImage("logo.png"), true);
+  }
+
+  Expect("page content offset", Opens(good, [](std::vector<char>& b, const Header& h) {
+    At<Page>(b, h.m_pageIndexOffset)->m_content = 0x7ffffff0;
+  }), false);
+  Expect("page content length", Opens(good, [](std::vector<char>& b, const Header& h) {
+    At<Page>(b, h.m_pageIndexOffset)->m_contentLen = h.m_stringTableSize;
+  }), false);
+  Expect("page name", Opens(good, [](std::vector<char>& b, const Header& h) {
+    At<Page>(b, h.m_pageIndexOffset + sizeof(Page))->m_name = h.m_stringTableSize;
+  }), false);
+  Expect("page buttons", Opens(good, [](std::vector<char>& b, const Header& h) {
+    At<Page>(b, h.m_pageIndexOffset)->m_firstButton = h.m_buttonCount;
+  }), false);
+  Expect("page tokens", Opens(good, [](std::vector<char>& b, const Header& h) {
+    At<Page>(b, h.m_pageIndexOffset)->m_tokenCount = 0xffffffff;
+  }), false);
+  Expect("token span", Opens(good, [](std::vector<char>& b, const Header& h) {
+    At<PageToken>(b, h.m_tokenTableOffset)->m_len = 0x10000;
+  }), false);
+  Expect("button string", Opens(good, [](std::vector<char>& b, const Header& h) {
+    At<Button>(b, h.m_buttonTableOffset)->m_cmd = 0xffffffff;
+  }), false);
+  Expect("unterminated strings", Opens(good, [](std::vector<char>& b, const Header& h) {
+    b[h.m_stringTableOffset + h.m_stringTableSize - 1] = 'x';
+  }), false);
+  Expect("image data offset", Opens(good, [](std::vector<char>& b, const Header& h) {
+    At<Image>(b, h.m_imageIndexOffset)->m_dataOffset = b.size() - 16;
+  }), false);
+  Expect("image stride", Opens(good, [](std::vector<char>& b, const Header& h) {
+    At<Image>(b, h.m_imageIndexOffset)->m_stride = 4;
+  }), false);
+  Expect("truncated", Opens(good, [](std::vector<char>& b, const Header&) {
+    b.resize(b.size() - 1);
+  }), false);
+
+  unlink(BundleFile);
+  printf("%s\n", failures ? "FAIL" : "PASS");
+  return failures ? 1 : 0;
+}
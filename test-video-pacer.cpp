@@ -0,0 +1,85 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <stdio.h>
+
+#include <cstdint>
+
+#include "video-pacer.h"
+
+namespace {
+constexpr int64_t Period = 40000;
+constexpr int Frames = 200;
+constexpr int StallFrame = 50;
+constexpr int64_t Stall = 60000;
+
+/// feeds 'Frames' frames a period apart, with one 'Stall' long hold up before 'StallFrame'. When
+/// 'burst' is set the frames held up behind the stall arrive back to back, as libvlc does when it
+/// catches up, otherwise everything after the stall arrives that much later.
+bool RunStall(const char *name, bool burst)
+{
+  VideoPacer pacer;
+  pacer.Retime(Period, 0);
+  int dropped = 0;
+  int droppedAfter = 0;
+  int64_t now = 0;
+  for(int frame = 0; frame < Frames; ++frame) {
+    if(frame == StallFrame)
+      now += Stall;
+    if(burst && frame > StallFrame && now > int64_t(frame) * Period)
+      now += 1000;
+    else if(frame)
+      now += Period;
+    if(pacer.DropFrame(now)) {
+      ++dropped;
+      if(frame > StallFrame + VideoPacer::MaxDropRun)
+        ++droppedAfter;
+    }
+  }
+  printf("%s: %d of %d dropped, %d after the stall settled\n", name, dropped, Frames, droppedAfter);
+  return dropped <= VideoPacer::MaxDropRun && !droppedAfter;
+}
+
+bool RunSteady()
+{
+  VideoPacer pacer;
+  pacer.Retime(Period, 0);
+  int dropped = 0;
+  for(int frame = 0; frame < Frames; ++frame)
+    dropped += pacer.DropFrame(int64_t(frame) * Period + (frame & 1) * 5000);
+  printf("steady: %d of %d dropped\n", dropped, Frames);
+  return !dropped;
+}
+
+bool RunNeverFreezes()
+{
+  // a decoder far too slow for the period still gets a frame shown every MaxDropRun + 1.
+  VideoPacer pacer;
+  pacer.Retime(Period, 0);
+  int run = 0;
+  int longest = 0;
+  for(int frame = 0; frame < Frames; ++frame) {
+    run = pacer.DropFrame(int64_t(frame) * Period * 3) ? run + 1 : 0;
+    if(run > longest)
+      longest = run;
+  }
+  printf("slow decoder: longest drop run %d\n", longest);
+  return longest <= VideoPacer::MaxDropRun;
+}
+}
+
+int main()
+{
+  bool ok = RunSteady();
+  ok = RunStall("stall", false) && ok;
+  ok = RunStall("stall then burst", true) && ok;
+  ok = RunNeverFreezes() && ok;
+  printf("%s\n", ok ? "PASS" : "FAIL");
+  return ok ? 0 : 1;
+}
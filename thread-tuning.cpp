@@ -0,0 +1,147 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include <cstddef>
+#include <algorithm>
+#include <thread>
+
+#include "thread-tuning.h"
+
+namespace {
+
+const char *PolicyName(SchedPolicy policy)
+{
+  switch(policy) {
+  case SCHED_POLICY_FIFO:
+    return "SCHED_FIFO";
+  default:
+    return "SCHED_RR";
+  }
+}
+
+/// the placement ApplyThreadPlacement last gave the calling thread.
+thread_local ThreadPlacement t_placement;
+
+/// the cores the process started on, taken before the first thread is moved.
+const cpu_set_t& ProcessCpus()
+{
+  static const cpu_set_t cpus = []() {
+    cpu_set_t set;
+    if(sched_getaffinity(0, sizeof(set), &set) != 0) {
+      CPU_ZERO(&set);
+      for(unsigned n = 0; n<CPU_SETSIZE; n++)
+	CPU_SET(n, &set);
+    }
+    return set;
+  }();
+  return cpus;
+}
+
+/// 'what' is null when putting a thread back after ScopedUnplacedThread, which is done quietly.
+bool PlaceThread(pthread_t thread, const ThreadPlacement& placement, const char *what)
+{
+  if(placement.IsDefault())
+    return true;
+
+  bool ok = true;
+  if(placement.m_cpuMask) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    for(unsigned n = 0; n<32; n++) {
+      if(placement.m_cpuMask & (1u << n))
+	CPU_SET(n, &cpus);
+    }
+    const int err = pthread_setaffinity_np(thread, sizeof(cpus), &cpus);
+    if(err != 0) {
+      if(what)
+	printf("Failed to put the %s on cores 0x%x: %s\n", what, placement.m_cpuMask, strerror(err));
+      ok = false;
+    }
+  }
+
+  int priority = 0;
+  if(placement.m_policy != SCHED_POLICY_NORMAL) {
+    const int policy = placement.m_policy == SCHED_POLICY_FIFO ? SCHED_FIFO : SCHED_RR;
+    priority = std::max(sched_get_priority_min(policy), std::min(sched_get_priority_max(policy), placement.m_priority));
+    sched_param param = {};
+    param.sched_priority = priority;
+    const int err = pthread_setschedparam(thread, policy, &param);
+    if(err != 0) {
+      if(what)
+	printf("Failed to give the %s %s: %s\n", what, PolicyName(placement.m_policy), strerror(err));
+      ok = false;
+    }
+  }
+
+  if(!ok || !what)
+    return ok;
+  if(placement.m_policy == SCHED_POLICY_NORMAL)
+    printf("The %s is on cores 0x%x\n", what, placement.m_cpuMask);
+  else if(placement.m_cpuMask)
+    printf("The %s is on cores 0x%x with %s priority %i\n", what, placement.m_cpuMask, PolicyName(placement.m_policy), priority);
+  else
+    printf("The %s has %s priority %i\n", what, PolicyName(placement.m_policy), priority);
+  return true;
+}
+
+}
+
+bool ApplyThreadPlacement(const ThreadPlacement& placement, const char *what)
+{
+  ProcessCpus();
+  t_placement = placement;
+  return PlaceThread(pthread_self(), placement, what);
+}
+
+bool ApplyThreadPlacement(std::thread& thread, const ThreadPlacement& placement, const char *what)
+{
+  return PlaceThread(thread.native_handle(), placement, what);
+}
+
+ScopedUnplacedThread::ScopedUnplacedThread() : m_placed(!t_placement.IsDefault())
+{
+  if(!m_placed)
+    return;
+  if(t_placement.m_policy != SCHED_POLICY_NORMAL) {
+    sched_param param = {};
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+  }
+  if(t_placement.m_cpuMask)
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &ProcessCpus());
+}
+
+ScopedUnplacedThread::~ScopedUnplacedThread()
+{
+  if(m_placed)
+    PlaceThread(pthread_self(), t_placement, nullptr);
+}
+
+bool LockMemory(const void *ptr, size_t size, const char *what)
+{
+  if(!ptr || !size)
+    return true;
+  if(mlock(ptr, size) != 0) {
+    printf("Failed to lock the %s (%zuKb) in memory: %s\n", what, size / 1024, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+void UnlockMemory(const void *ptr, size_t size)
+{
+  if(ptr && size)
+    munlock(ptr, size);
+}
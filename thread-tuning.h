@@ -0,0 +1,51 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+enum SchedPolicy {
+  SCHED_POLICY_NORMAL,	///< left to the kernel's normal time sharing
+  SCHED_POLICY_FIFO,	///< SCHED_FIFO, runs until it blocks or something higher priority wants the core
+  SCHED_POLICY_RR	///< SCHED_RR, the same but taking turns with others at its priority
+};
+
+/// Which cores a thread runs on and how it is scheduled. The defaults change nothing.
+struct ThreadPlacement {
+  /// bit n allows core n, zero leaves the thread wherever the kernel puts it.
+  unsigned m_cpuMask = 0;
+  SchedPolicy m_policy = SCHED_POLICY_NORMAL;
+  /// the real time priority, clamped to what the policy allows.
+  int m_priority = 0;
+
+  bool IsDefault() const { return m_cpuMask == 0 && m_policy == SCHED_POLICY_NORMAL; }
+};
+
+/// Moves the calling thread, or 'thread', to its cores and scheduling policy. Threads it starts
+/// afterwards inherit both, see ScopedUnplacedThread. Real time scheduling needs root or CAP_SYS_NICE, when something isn't
+/// allowed it says so and returns false, leaving the thread running as it was. 'what' names the
+/// thread in the messages.
+bool ApplyThreadPlacement(const ThreadPlacement& placement, const char *what);
+bool ApplyThreadPlacement(std::thread& thread, const ThreadPlacement& placement, const char *what);
+
+/// Threads inherit the cores and scheduling of the thread that starts them, including ones started
+/// inside libraries such as libvlc. For its lifetime this puts the calling thread back the way it
+/// was before ApplyThreadPlacement, so anything started meanwhile doesn't end up on the placed cores.
+class ScopedUnplacedThread {
+public:
+  ScopedUnplacedThread();
+  ~ScopedUnplacedThread();
+
+private:
+  bool m_placed;
+};
+
+/// keeps 'size' bytes from 'ptr' in RAM so touching them never waits on a page fault, this is
+/// limited by RLIMIT_MEMLOCK for anyone but root.
+bool LockMemory(const void *ptr, size_t size, const char *what);
+void UnlockMemory(const void *ptr, size_t size);
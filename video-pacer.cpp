@@ -0,0 +1,31 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#include <cstdint>
+
+#include "video-pacer.h"
+
+void VideoPacer::Retime(int64_t period, int64_t now)
+{
+  m_period = period;
+  m_due = now;
+  m_dropRun = 0;
+}
+
+bool VideoPacer::DropFrame(int64_t now)
+{
+  if(now - m_due > m_period && m_dropRun < MaxDropRun) {
+    ++m_dropRun;
+    m_due += m_period;
+    return true;
+  }
+  m_dropRun = 0;
+  m_due = now + m_period;
+  return false;
+}
@@ -0,0 +1,33 @@
+/*
+Copyright (c) 2024 Carri King
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+/// Decides which video frames to skip. libvlc's display callback carries no timestamp, so each
+/// frame is due a frame period after the last one shown. A frame more than a period late is
+/// dropped to catch up, but never more than MaxDropRun in a row so the picture never freezes.
+/// Showing a frame starts the schedule again from then, so one stall costs a few frames at most.
+class VideoPacer {
+public:
+  static constexpr int MaxDropRun = 4;
+
+  /// starts a new schedule of 'period' microseconds with a frame due at 'now'.
+  void Retime(int64_t period, int64_t now);
+  /// true if the frame arriving at 'now' should be dropped, times are in microseconds.
+  bool DropFrame(int64_t now);
+
+  bool IsTimed() const { return m_period != 0; }
+  /// forgets the schedule, the next frame has to Retime.
+  void Reset() { m_period = 0; m_dropRun = 0; }
+
+private:
+  int64_t m_due = 0;
+  int64_t m_period = 0;
+  int m_dropRun = 0;
+};